@@ -0,0 +1,196 @@
+// Board microbenchmarks: mailbox vs bitboard piece lookup, set/remove,
+// occupancy and copy cost
+//
+//   make bench
+//
+// MailboxBoard is the old layout of Board (mailbox + 12 bitboards, 176
+// bytes) kept here as the reference for the comparison
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "gamestate.hpp"
+
+class MailboxBoard {
+public:
+  inline explicit MailboxBoard(const Board &b) : mailbox{}, pieces{} {
+    for (int sq = 0; sq < 64; ++sq)
+      set_piece(static_cast<uint8_t>(sq), b.piece_at(static_cast<uint8_t>(sq)));
+  }
+
+  constexpr Piece get_piece_in_mailbox_at(Square sq) const {
+    return mailbox.at(sq);
+  }
+
+  constexpr Piece get_piece_in_bitboard_at(Square sq) const {
+    for (int i = 1; i < Piece::Type::PIECE_NB; ++i) {
+      if (pieces.at(Piece::Color::WHITE).at(i) & Square::to_uint64(sq))
+        return Piece(Piece::Color::WHITE, static_cast<Piece::Type>(i));
+      if (pieces.at(Piece::Color::BLACK).at(i) & Square::to_uint64(sq))
+        return Piece(Piece::Color::BLACK, static_cast<Piece::Type>(i));
+    }
+    return Piece::empty();
+  }
+
+  constexpr uint64_t occupancy() const {
+    uint64_t occ = 0;
+    for (int t = Piece::Type::PAWN; t < Piece::Type::PIECE_NB; ++t)
+      occ |= pieces[Piece::Color::WHITE][t] | pieces[Piece::Color::BLACK][t];
+    return occ;
+  }
+
+  constexpr void set_piece(Square to, Piece p) {
+    if (p) {
+      mailbox.at(to) = p;
+      pieces.at(p.color()).at(p.type()) |= Square::to_uint64(to);
+    }
+  }
+
+  constexpr void remove_piece(Square sq) {
+    const Piece p = get_piece_in_mailbox_at(sq);
+    if (p) {
+      mailbox.at(sq) = Piece::empty();
+      pieces.at(p.color()).at(p.type()) &= ~Square::to_uint64(sq);
+    }
+  }
+
+private:
+  std::array<Piece, 64> mailbox;
+  std::array<std::array<uint64_t, Piece::Type::PIECE_NB>,
+             Piece::Color::COLOR_NB>
+      pieces;
+};
+
+// Run f(i) for i in [0, n) and print the time per call, the checksum keeps
+// the compiler from removing the work
+template <typename F>
+static void bench(const char *name, std::size_t n, F &&f) {
+  uint64_t checksum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < n; ++i)
+    checksum += f(i);
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::printf("%-36s %8.2f ns/op   (checksum %llu)\n", name,
+              elapsed.count() / n, static_cast<unsigned long long>(checksum));
+}
+
+int main() {
+  constexpr std::size_t POSITIONS = 4096;
+  constexpr std::size_t N = 1 << 24;
+
+  // positions in the middle of random games from Chess960 starts
+  std::mt19937_64 rng(42);
+  std::vector<Board> boards;
+  std::vector<GameState> states;
+  while (boards.size() < POSITIONS) {
+    GameState gs = GameState::init_960(rng() % 960);
+    // random captures and moves, not legal but with a realistic density
+    for (int ply = 0; ply < 40; ++ply) {
+      const Square sq = static_cast<uint8_t>(rng() % 64);
+      const Square to = static_cast<uint8_t>(rng() % 64);
+      const Piece p = gs.board().piece_at(sq);
+      const Piece target = gs.board().piece_at(to);
+      if (!p || p.color() != gs.turn() || p.is_king() || target.is_king() ||
+          (target && target.color() == gs.turn()))
+        continue;
+      gs.make_move(Move(sq, to));
+    }
+    boards.push_back(gs.board());
+    states.push_back(gs);
+  }
+  std::vector<MailboxBoard> mailboxes;
+  for (const Board &b : boards)
+    mailboxes.emplace_back(b);
+
+  // random (position, square) pairs, the same for all the lookups
+  std::vector<uint32_t> queries(N);
+  for (auto &q : queries)
+    q = static_cast<uint32_t>(rng() % POSITIONS << 6 | rng() % 64);
+
+  std::printf("sizeof(Board) %zu, sizeof(MailboxBoard) %zu, "
+              "sizeof(GameState) %zu\n\n",
+              sizeof(Board), sizeof(MailboxBoard), sizeof(GameState));
+
+  std::printf("piece lookup (random square)\n");
+  bench("  mailbox", N, [&](std::size_t i) {
+    const uint32_t q = queries[i];
+    return uint8_t(mailboxes[q >> 6].get_piece_in_mailbox_at(q & 63));
+  });
+  bench("  bitboard loop (old)", N, [&](std::size_t i) {
+    const uint32_t q = queries[i];
+    return uint8_t(mailboxes[q >> 6].get_piece_in_bitboard_at(q & 63));
+  });
+  bench("  Board::piece_at", N, [&](std::size_t i) {
+    const uint32_t q = queries[i];
+    return uint8_t(boards[q >> 6].piece_at(q & 63));
+  });
+
+  std::printf("piece lookup (all squares of a position)\n");
+  bench("  mailbox", N / 64, [&](std::size_t i) {
+    const MailboxBoard &b = mailboxes[i % POSITIONS];
+    uint64_t sum = 0;
+    for (int sq = 0; sq < 64; ++sq)
+      sum += uint8_t(b.get_piece_in_mailbox_at(static_cast<uint8_t>(sq)));
+    return sum;
+  });
+  bench("  Board::piece_at", N / 64, [&](std::size_t i) {
+    const Board &b = boards[i % POSITIONS];
+    uint64_t sum = 0;
+    for (int sq = 0; sq < 64; ++sq)
+      sum += uint8_t(b.piece_at(static_cast<uint8_t>(sq)));
+    return sum;
+  });
+
+  std::printf("set + remove\n");
+  bench("  mailbox", N, [&](std::size_t i) {
+    const uint32_t q = queries[i];
+    MailboxBoard &b = mailboxes[q >> 6];
+    const Square sq = q & 63;
+    const Piece p = b.get_piece_in_mailbox_at(sq);
+    b.remove_piece(sq);
+    b.set_piece(sq, p);
+    return uint8_t(p);
+  });
+  bench("  Board", N, [&](std::size_t i) {
+    const uint32_t q = queries[i];
+    Board &b = boards[q >> 6];
+    const Square sq = q & 63;
+    const Piece p = b.piece_at(sq);
+    b.remove_piece(sq);
+    b.set_piece(sq, p);
+    return uint8_t(p);
+  });
+
+  std::printf("occupancy\n");
+  bench("  loop over the bitboards (old)", N, [&](std::size_t i) {
+    return mailboxes[queries[i] >> 6].occupancy();
+  });
+  bench("  Board::occupancy", N, [&](std::size_t i) {
+    return boards[queries[i] >> 6].occupancy();
+  });
+
+  // copies into a small ring, like the positions of a search stack, then the
+  // same read (occupancy) of another slot for all of them
+  std::printf("copy\n");
+  std::vector<MailboxBoard> mailboxStack(64, mailboxes[0]);
+  std::vector<Board> boardStack(64);
+  std::vector<GameState> stateStack(64);
+  bench("  MailboxBoard", N, [&](std::size_t i) {
+    mailboxStack[i & 63] = mailboxes[queries[i] >> 6];
+    return mailboxStack[i * 7 & 63].occupancy();
+  });
+  bench("  Board", N, [&](std::size_t i) {
+    boardStack[i & 63] = boards[queries[i] >> 6];
+    return boardStack[i * 7 & 63].occupancy();
+  });
+  bench("  GameState", N, [&](std::size_t i) {
+    stateStack[i & 63] = states[queries[i] >> 6];
+    return stateStack[i * 7 & 63].board().occupancy();
+  });
+  return 0;
+}
@@ -0,0 +1,101 @@
+// PackedPosition microbenchmarks: pack and unpack throughput
+//
+//   make bench
+//
+// unpack_by_piece is the old decoder (a Board::set_piece call per piece)
+// kept here as the reference for the comparison
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "movegen.hpp"
+#include "packed.hpp"
+
+// Decode piece by piece, with the pieces read by for_each_piece
+static GameState unpack_by_piece(const PackedPosition &p,
+                                 const GameState &fields) {
+  Board b = Board::empty();
+  p.for_each_piece([&](Square sq, Piece piece) { b.set_piece(sq, piece); });
+  return GameState(b, p.turn(), fields.castleRights(),
+                   fields.enPassantSquare(), fields.halfMoveClock(),
+                   fields.fullMoveNumber());
+}
+
+// Every word of the result, so no part of the work can be removed
+static uint64_t fold(const PackedPosition &p) {
+  uint64_t h = 0;
+  for (uint64_t w : std::bit_cast<std::array<uint64_t, 4>>(p))
+    h = h * 31 + w;
+  return h;
+}
+
+static uint64_t fold(const GameState &gs) {
+  uint64_t h = gs.turn();
+  for (int c = 0; c < Piece::Color::COLOR_NB; ++c)
+    for (int t = Piece::Type::PAWN; t < Piece::Type::PIECE_NB; ++t)
+      h = h * 31 + gs.board().bitboard(static_cast<Piece::Color>(c),
+                                       static_cast<Piece::Type>(t));
+  return h;
+}
+
+// Run f(i) for i in [0, n) and print the time per call and the rate, the
+// checksum keeps the compiler from removing the work
+template <typename F>
+static void bench(const char *name, std::size_t n, F &&f) {
+  uint64_t checksum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < n; ++i)
+    checksum += f(i);
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::printf("%-36s %8.2f ns/op %8.1f M/s   (checksum %llu)\n", name,
+              elapsed.count() / n, n / elapsed.count() * 1e3,
+              static_cast<unsigned long long>(checksum));
+}
+
+int main() {
+  constexpr std::size_t POSITIONS = 4096;
+  constexpr std::size_t N = 1 << 22;
+
+  // positions of random legal games from Chess960 starts
+  std::mt19937_64 rng(42);
+  std::vector<GameState> states;
+  std::vector<PackedPosition> packed;
+  while (states.size() < POSITIONS) {
+    GameState gs = GameState::init_960(static_cast<int>(rng() % 960));
+    const int plies = static_cast<int>(rng() % 80);
+    for (int ply = 0; ply < plies; ++ply) {
+      const MoveList moves = MoveGen::legal_moves(gs);
+      if (moves.empty())
+        break;
+      gs.make_move(moves[static_cast<int>(rng() % moves.size())]);
+    }
+    states.push_back(gs);
+    packed.emplace_back(gs);
+  }
+
+  std::printf("sizeof(PackedPosition) %zu, sizeof(GameState) %zu\n\n",
+              sizeof(PackedPosition), sizeof(GameState));
+
+  bench("PackedPosition(GameState)", N, [&](std::size_t i) {
+    return fold(PackedPosition(states[i % POSITIONS]));
+  });
+  bench("unpack", N, [&](std::size_t i) {
+    return fold(packed[i % POSITIONS].unpack());
+  });
+  bench("unpack_by_piece (old)", N, [&](std::size_t i) {
+    const std::size_t k = i % POSITIONS;
+    return fold(unpack_by_piece(packed[k], states[k]));
+  });
+  bench("pack + unpack round trip", N, [&](std::size_t i) {
+    const GameState &gs = states[i % POSITIONS];
+    return uint64_t(PackedPosition(gs).unpack() == gs);
+  });
+  return 0;
+}
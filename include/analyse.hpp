@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cctype>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cli.hpp"
+#include "epd.hpp"
+#include "search.hpp"
+#include "threadpool.hpp"
+
+/*
+Batch analysis of an EPD/FEN file
+
+  tiresia analyse --input positions.epd [--output results.epd] [--depth N]
+                  [--nodes N] [--threads T] [--pin] [--params params.txt]
+                  [--hash MB]
+
+The input is read one line at a time and every position is searched by one
+of the workers of the pool, each worker has its own Searcher (with a
+transposition table of --hash MB, built by the worker itself so that with
+--pin its memory is on the node of the worker). The results are
+written in input order as EPD records:
+
+  <4 FEN fields> acd <depth>; acn <nodes>; ce <score>; bm <move>; pv <moves>;
+  id "..."; (only if the input has an id)
+
+An invalid record is not skipped, its slot gets the input line followed by
+the error, so the output has a line for every record of the input:
+
+  <input line> error "<message>";
+
+At most 'window' positions are in flight at the same time, so the memory does
+not depend on the size of the input.
+*/
+
+class Analyse {
+public:
+  struct Options {
+    std::string input;
+    std::string output; // empty = stdout
+    SearchLimits limits;
+    std::size_t threads = ThreadPool::default_threads();
+    bool pin = false;
+    std::size_t window = 0; // 0 = 64 positions per thread
+    std::size_t hash = TranspositionTable::DEFAULT_MB; // by searcher
+  };
+
+  static inline Options options(const Args &args) {
+    Options opt;
+    opt.input = args.get("input");
+    if (opt.input.empty())
+      throw std::runtime_error("analyse: missing --input");
+    opt.output = args.get("output");
+    opt.limits.depth = args.get_int("depth", 8);
+    opt.limits.nodes = args.get_int("nodes", 0);
+    if (args.has("params"))
+      opt.limits.params = std::make_shared<const EvalParams>(
+          EvalParams::load(args.get("params")));
+    opt.threads = args.get_int("threads", opt.threads);
+    opt.pin = args.has("pin");
+    opt.window = args.get_int("window", 0);
+    opt.hash = args.get_int("hash", opt.hash);
+    return opt;
+  }
+
+  static inline int run(const Args &args) { return run(options(args)); }
+
+  static inline int run(const Options &opt) {
+    std::ifstream in(opt.input);
+    if (!in)
+      throw std::runtime_error("analyse: cannot open " + opt.input);
+
+    std::ofstream file;
+    if (!opt.output.empty()) {
+      file.open(opt.output);
+      if (!file)
+        throw std::runtime_error("analyse: cannot open " + opt.output);
+    }
+    std::ostream &out = opt.output.empty() ? std::cout : file;
+
+    return run(in, out, opt);
+  }
+
+  // Returns the number of invalid records
+  static inline int run(std::istream &in, std::ostream &out,
+                        const Options &opt) {
+    ThreadPool pool(opt.threads, opt.pin);
+    // created by their worker on its first position
+    std::vector<std::unique_ptr<Searcher>> searchers(pool.size());
+    OrderedWriter writer(out);
+    const std::size_t window = opt.window ? opt.window : 64 * pool.size();
+
+    int errors = 0;
+    std::mutex errors_mutex;
+
+    std::string line;
+    std::size_t index = 0, number = 0;
+    while (std::getline(in, line)) {
+      ++number;
+      if (!Epd::is_record(line))
+        continue;
+
+      writer.wait_below(index, window);
+      pool.submit([&, line, index, number](std::size_t worker) {
+        std::string result;
+        try {
+          const Epd epd(line);
+          if (!searchers[worker])
+            searchers[worker] = std::make_unique<Searcher>(
+                TranspositionTable::entries(opt.hash));
+          const SearchResult r =
+              searchers[worker]->search(epd.gamestate(), opt.limits);
+          result = format(epd, r);
+        } catch (const std::exception &e) {
+          std::fprintf(stderr, "analyse: line %zu: %s\n", number, e.what());
+          result = error(line, e.what());
+          std::lock_guard lock(errors_mutex);
+          ++errors;
+        }
+        writer.put(index, std::move(result));
+      });
+      ++index;
+    }
+
+    pool.wait();
+    out.flush();
+    return errors;
+  }
+
+  // Record of an invalid input line (the quotes of the message are removed,
+  // they would end the string)
+  static inline std::string error(std::string line, std::string message) {
+    while (!line.empty() && std::isspace(static_cast<unsigned char>(
+                                line.back())))
+      line.pop_back();
+    std::erase(message, '"');
+    return line + " error \"" + message + "\";";
+  }
+
+  static inline std::string format(const Epd &epd, const SearchResult &r) {
+    std::string s = epd.position;
+    s += " acd " + std::to_string(r.depth) + ';';
+    s += " acn " + std::to_string(r.nodes) + ';';
+    s += " ce " + std::to_string(r.score) + ';';
+    if (r.bestMove)
+      s += " bm " + r.bestMove->to_string() + ';';
+    if (!r.pv.empty()) {
+      s += " pv";
+      for (const Move &m : r.pv)
+        s += ' ' + m.to_string();
+      s += ';';
+    }
+    const std::string id = epd.operation("id");
+    if (!id.empty())
+      s += " id " + id + ';';
+    return s;
+  }
+
+private:
+  // Writes the results in order of index, even if they are completed out of
+  // order
+  class OrderedWriter {
+  public:
+    inline explicit OrderedWriter(std::ostream &out) : out(out) {}
+
+    inline void put(std::size_t index, std::string result) {
+      std::lock_guard lock(mutex);
+      pending.emplace(index, std::move(result));
+      for (auto it = pending.begin();
+           it != pending.end() && it->first == next;
+           it = pending.erase(it), ++next)
+        out << it->second << '\n';
+      written.notify_all();
+    }
+
+    // Block until less than window results are not yet written
+    inline void wait_below(std::size_t index, std::size_t window) {
+      std::unique_lock lock(mutex);
+      written.wait(lock, [&] { return index - next < window; });
+    }
+
+  private:
+    std::ostream &out;
+    std::mutex mutex;
+    std::condition_variable written;
+    std::map<std::size_t, std::string> pending;
+    std::size_t next = 0; // index of the next result to write
+  };
+};
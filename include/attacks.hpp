@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#include "piece.hpp"
+
+/*
+Attack bitboards of the pieces, the tables are built at compile time
+
+Sliding pieces use the classical approach: a ray per direction and square,
+cut at the first blocker (found with a bit scan)
+
+  | Direction | Step | First blocker |
+  | --------- | ---- | ------------- |
+  | N         | +8   | lowest bit    |
+  | NE        | +9   | lowest bit    |
+  | E         | +1   | lowest bit    |
+  | NW        | +7   | lowest bit    |
+  | S         | -8   | highest bit   |
+  | SW        | -9   | highest bit   |
+  | W         | -1   | highest bit   |
+  | SE        | -7   | highest bit   |
+*/
+
+class Attacks {
+public:
+  enum Direction { N, NE, E, NW, S, SW, W, SE, DIRECTION_NB };
+
+  static constexpr uint64_t knight(int sq) { return KNIGHT[sq]; }
+  static constexpr uint64_t king(int sq) { return KING[sq]; }
+  // squares attacked by a pawn of color c on sq
+  static constexpr uint64_t pawn(Piece::Color c, int sq) {
+    return PAWN[c][sq];
+  }
+
+  static constexpr uint64_t bishop(int sq, uint64_t occupancy) {
+    return ray(NE, sq, occupancy) | ray(NW, sq, occupancy) |
+           ray(SE, sq, occupancy) | ray(SW, sq, occupancy);
+  }
+  static constexpr uint64_t rook(int sq, uint64_t occupancy) {
+    return ray(N, sq, occupancy) | ray(E, sq, occupancy) |
+           ray(S, sq, occupancy) | ray(W, sq, occupancy);
+  }
+  static constexpr uint64_t queen(int sq, uint64_t occupancy) {
+    return bishop(sq, occupancy) | rook(sq, occupancy);
+  }
+
+  // Squares attacked by a piece of type t (and color c for the pawns) on sq
+  static constexpr uint64_t of(Piece::Type t, Piece::Color c, int sq,
+                               uint64_t occupancy) {
+    switch (t) { // clang-format off
+    case Piece::Type::PAWN:   return pawn(c, sq);
+    case Piece::Type::KNIGHT: return knight(sq);
+    case Piece::Type::BISHOP: return bishop(sq, occupancy);
+    case Piece::Type::ROOK:   return rook(sq, occupancy);
+    case Piece::Type::QUEEN:  return queen(sq, occupancy);
+    case Piece::Type::KING:   return king(sq);
+    default:                  return 0;
+    } // clang-format on
+  }
+
+  // Squares strictly between a and b on the same line (0 if none)
+  static constexpr uint64_t between(int a, int b) { return BETWEEN[a][b]; }
+
+private:
+  // attacks of a ray from sq, up to the first blocker included
+  static constexpr uint64_t ray(Direction d, int sq, uint64_t occupancy) {
+    const uint64_t attacks = RAYS[d][sq];
+    const uint64_t blockers = attacks & occupancy;
+    if (!blockers)
+      return attacks;
+    const int first = d < S ? std::countr_zero(blockers)
+                            : 63 - std::countl_zero(blockers);
+    return attacks ^ RAYS[d][first];
+  }
+
+  // bitboard of the squares reached from sq with the steps (file, rank),
+  // repeated if slide
+  static constexpr uint64_t walk(int sq, int df, int dr, bool slide) {
+    uint64_t bb = 0;
+    int f = sq % 8 + df, r = sq / 8 + dr;
+    for (; f >= 0 && f < 8 && r >= 0 && r < 8; f += df, r += dr) {
+      bb |= 1ULL << (r * 8 + f);
+      if (!slide)
+        break;
+    }
+    return bb;
+  }
+
+  // (file, rank) step of every direction
+  static constexpr int STEPS[DIRECTION_NB][2] = {
+      {0, 1}, {1, 1}, {1, 0}, {-1, 1}, {0, -1}, {-1, -1}, {-1, 0}, {1, -1}};
+
+  using Table = std::array<uint64_t, 64>;
+
+  // the tables are defined after the class, walk() is not usable in a
+  // constant expression before the class is complete
+  static const std::array<Table, DIRECTION_NB> RAYS;
+  static const Table KNIGHT, KING;
+  static const std::array<Table, Piece::Color::COLOR_NB> PAWN;
+  static const std::array<Table, 64> BETWEEN;
+};
+
+inline constexpr std::array<Attacks::Table, Attacks::DIRECTION_NB>
+    Attacks::RAYS = [] {
+  std::array<Table, DIRECTION_NB> rays{};
+  for (int d = 0; d < DIRECTION_NB; ++d)
+    for (int sq = 0; sq < 64; ++sq)
+      rays[d][sq] = walk(sq, STEPS[d][0], STEPS[d][1], true);
+  return rays;
+}();
+
+inline constexpr Attacks::Table Attacks::KNIGHT = [] {
+  constexpr int jumps[8][2] = {{1, 2},   {2, 1},   {2, -1}, {1, -2},
+                               {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+  Table t{};
+  for (int sq = 0; sq < 64; ++sq)
+    for (const auto &j : jumps)
+      t[sq] |= walk(sq, j[0], j[1], false);
+  return t;
+}();
+
+inline constexpr Attacks::Table Attacks::KING = [] {
+  Table t{};
+  for (int sq = 0; sq < 64; ++sq)
+    for (const auto &s : STEPS)
+      t[sq] |= walk(sq, s[0], s[1], false);
+  return t;
+}();
+
+inline constexpr std::array<Attacks::Table, Piece::Color::COLOR_NB>
+    Attacks::PAWN = [] {
+  std::array<Table, Piece::Color::COLOR_NB> t{};
+  for (int sq = 0; sq < 64; ++sq) {
+    t[Piece::Color::WHITE][sq] =
+        walk(sq, -1, 1, false) | walk(sq, 1, 1, false);
+    t[Piece::Color::BLACK][sq] =
+        walk(sq, -1, -1, false) | walk(sq, 1, -1, false);
+  }
+  return t;
+}();
+
+inline constexpr std::array<Attacks::Table, 64> Attacks::BETWEEN = [] {
+  std::array<Table, 64> t{};
+  for (int a = 0; a < 64; ++a)
+    for (int d = 0; d < DIRECTION_NB; ++d)
+      for (uint64_t bb = RAYS[d][a]; bb; bb &= bb - 1) {
+        const int b = std::countr_zero(bb);
+        t[a][b] = RAYS[d][a] & ~RAYS[d][b] & ~(1ULL << b);
+      }
+  return t;
+}();
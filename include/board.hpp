@@ -2,11 +2,13 @@
 
 #include <array>
 #include <cassert>
+#include <cctype>
 #include <cstdint>
 #include <optional>
 #include <regex>
 #include <string>
 
+#include "attacks.hpp"
 #include "move.hpp"
 #include "piece.hpp"
 
@@ -30,9 +32,10 @@ for a better understanding of how the board is represented see the move.hpp file
 
 class Board {
 private:
-  // total size = 1408 bits = 176 bytes
-  std::array<Piece, 64> mailbox; // 64 * 8 bits = 512 bits
-  union {                        // 2 * 7 * 64 bits = 896 bits
+  // total size = 960 bits = 120 bytes (2 cache lines with the GameState
+  // fields), there is no mailbox: the piece on a square is read from the
+  // bitboards (see bench/bench_board.cpp for the comparison)
+  union { // 2 * 7 * 64 bits = 896 bits
     std::array<std::array<uint64_t, Piece::Type::PIECE_NB>,
                Piece::Color::COLOR_NB>
         pieces; // 0 = white, 1 = black
@@ -43,69 +46,103 @@ private:
       std::array<uint64_t, Piece::Type::PIECE_NB> black;
     };
   };
+  uint64_t all; // all the pieces on the board, 64 bits
 
 public:
   // Constructors
-  constexpr explicit Board() : mailbox{}, pieces{{}} {}
+  constexpr explicit Board() : pieces{{}}, all(0) {}
   constexpr Board(const Board &b) = default;
   // FEN ref: https://it.wikipedia.org/wiki/Notazione_Forsyth-Edwards
-  inline Board(const std::string &fen) { set_from_fen(fen); }
+  inline Board(const std::string &fen) : Board() { set_from_fen(fen); }
 
   // Factory functions
   static constexpr Board empty() { return Board(); }
   static inline Board from_fen(const std::string &fen) { return Board(fen); }
 
+  using Bitboards = std::array<std::array<uint64_t, Piece::Type::PIECE_NB>,
+                               Piece::Color::COLOR_NB>;
+  // Board from the bitboards of the pieces by color and type, the index 0
+  // (occupancy of the color) is ignored and computed (the bitboards must not
+  // overlap)
+  static constexpr Board from_bitboards(const Bitboards &bitboards) {
+    Board b;
+    b.pieces = bitboards;
+    for (auto &color : b.pieces) {
+      color[0] = 0;
+      for (int t = Piece::Type::PAWN; t < Piece::Type::PIECE_NB; ++t)
+        color[0] |= color[t];
+    }
+    b.all = b.white[0] | b.black[0];
+    return b;
+  }
+
   // Conversion
   inline Board &operator=(const Board &b) = default;
 
-  // Get piece at square sq from the mailbox (technically more efficient than
-  // get_piece_in_bitboard_at)
-  constexpr Piece get_piece_in_mailbox_at(Square sq) const {
-    return mailbox.at(static_cast<int>(sq));
+  // Get piece at square sq
+  // The color is the bit of the square in the black occupancy and the type is
+  // the sum of the bits of the square in the bitboards of both colors (only
+  // one is set): no loop and no branch
+  constexpr Piece piece_at(Square sq) const {
+    check(sq);
+    // 1 if there is a piece of type t (of any color) on sq
+    const uint64_t mask = Square::to_uint64(sq);
+    auto bit = [&](Piece::Type t) -> uint64_t {
+      const uint64_t bb =
+          pieces[Piece::Color::WHITE][t] | pieces[Piece::Color::BLACK][t];
+      return (bb & mask) != 0;
+    };
+    const uint64_t type =
+        bit(Piece::Type::PAWN) * 1 + bit(Piece::Type::KNIGHT) * 2 +
+        bit(Piece::Type::BISHOP) * 3 + bit(Piece::Type::ROOK) * 4 +
+        bit(Piece::Type::QUEEN) * 5 + bit(Piece::Type::KING) * 6;
+    const uint64_t color = (pieces[Piece::Color::BLACK][0] & mask) != 0;
+    const uint64_t empty = (all & mask) == 0;
+    // an empty square is NO_COLOR | NO_PIECE
+    return Piece(static_cast<uint8_t>(color << 6 | type | empty * 0b11000000));
   }
 
-  // Get piece at square sq from the bitboard (the only useful case is when you
-  // want to use the bitboard a lot by improving the use of the cache) (((maybe,
-  // sould be tested!)))
-  // TODO: check if it's worth it in some cases
-  constexpr Piece get_piece_in_bitboard_at(Square sq) const {
-    for (int i = 1; i < Piece::Type::PIECE_NB; ++i) {
-      if (pieces.at(Piece::Color::WHITE).at(i) & Square::to_uint64(sq)) {
-        return Piece(Piece::Color::WHITE, static_cast<Piece::Type>(i));
-      }
-      if (pieces.at(Piece::Color::BLACK).at(i) & Square::to_uint64(sq)) {
-        return Piece(Piece::Color::BLACK, static_cast<Piece::Type>(i));
-      }
-    }
-    return Piece::empty();
+  // Get the bitboard of the pieces of color c and type t (t = NO_PIECE for
+  // all the pieces of color c)
+  constexpr uint64_t bitboard(Piece::Color c, Piece::Type t) const {
+    return pieces[c][t];
   }
 
-  // Set piece at square sq
+  // Get the bitboard of all the pieces on the board
+  constexpr uint64_t occupancy() const { return all; }
+  // Get the bitboard of all the pieces of color c
+  constexpr uint64_t occupancy(Piece::Color c) const { return pieces[c][0]; }
+
+  // Same pieces on the same squares
+  constexpr bool operator==(const Board &b) const {
+    return pieces == b.pieces;
+  }
+
+  // Set piece at square sq, the piece already on sq (if any) is replaced
   // Note do not use set_piece(sq) instead of remove_piece(sq)
   constexpr void set_piece(Square to, Piece p = Piece::empty()) {
+    check(to);
+    const uint64_t bit = Square::to_uint64(to);
+    vacate(bit);
     if (p) [[likely]] {
-      mailbox.at(static_cast<int>(to)) = p;
-      pieces.at(p.color()).at(p.type()) |= Square::to_uint64(to);
-    } else [[unlikely]] {
-      remove_piece(to);
+      pieces[p.color()][p.type()] |= bit;
+      pieces[p.color()][0] |= bit;
+      all |= bit;
     }
   }
 
   // Remove piece at square sq
   // Note: do not use set_piece(sq) instead of remove_piece(sq)
   constexpr void remove_piece(Square sq) {
-    Piece p = get_piece_in_mailbox_at(sq);
-    if (p) {
-      mailbox.at(static_cast<int>(sq)) = Piece::empty();
-      pieces.at(p.color()).at(p.type()) &= ~(Square::to_uint64(sq));
-    }
+    check(sq);
+    vacate(Square::to_uint64(sq));
   }
 
   // Get the available moves for a piece at square sq
   // TODO
   inline std::vector<Move> get_moves_for_piece_at(Square sq) const {
     std::vector<Move> moves;
-    const Piece p = get_piece_in_bitboard_at(sq);
+    const Piece p = piece_at(sq);
     if (p) {
       switch (p.type()) {
       case Piece::Type::PAWN:
@@ -120,12 +157,16 @@ public:
     return moves;
   }
 
-  // Move piece 'from' to 'to'
+  // Move piece 'from' to 'to', the piece on 'to' (if any) is captured
   constexpr void move_piece(Square from, Square to) {
-    const Piece p = get_piece_in_mailbox_at(from);
-    if (p) [[likely]] {
-      remove_piece(from);
-      set_piece(to, p);
+    check(to);
+    const Piece p = piece_at(from);
+    if (p && from != to) [[likely]] {
+      vacate(Square::to_uint64(to));
+      const uint64_t bits = Square::to_uint64(from, to);
+      pieces[p.color()][p.type()] ^= bits;
+      pieces[p.color()][0] ^= bits;
+      all ^= bits;
     }
   }
 
@@ -153,7 +194,7 @@ public:
       std::printf("%d ", rank + 1);
       for (int file = 0; file < 8; ++file) {
         int index = rank * 8 + file;
-        const auto &piece = mailbox[index];
+        const Piece piece = piece_at(static_cast<Square>(index));
         std::string str = get_piece_rapresentation(piece);
         std::printf("%s ", static_cast<const char *>(str.c_str()));
       }
@@ -168,12 +209,60 @@ public:
     return Board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR");
   }
 
-  // TODO
   // Fischer-Random:
   // https://en.wikipedia.org/wiki/Fischer%E2%80%93Random_chess_move_generation
-  // for now it's a random position for tests purposes
-  static inline Board init_960() {
-    return Board("nqrkrbbn/pppppppp/8/8/8/8/PPPPPPPP/NQRKRBBN");
+  // index in [0, 960) with the Scharnagl numbering (518 = standard position)
+  // ref: https://en.wikipedia.org/wiki/Fischer_random_chess_numbering_scheme
+  static inline Board init_960(int index) {
+    if (index < 0 || index >= 960)
+      throw std::runtime_error("Invalid Chess960 index");
+
+    std::string rank(8, ' ');
+    // place p on the n-th empty file
+    auto place = [&](int n, char p) {
+      for (int file = 0; file < 8; ++file)
+        if (rank[file] == ' ' && n-- == 0) {
+          rank[file] = p;
+          return;
+        }
+    };
+
+    rank[(index % 4) * 2 + 1] = 'B'; // light square bishop (b, d, f, h)
+    index /= 4;
+    rank[(index % 4) * 2] = 'B'; // dark square bishop (a, c, e, g)
+    index /= 4;
+    place(index % 6, 'Q');
+    index /= 6;
+    // the 10 ways to place 2 knights on the 5 empty files
+    static constexpr int knights[10][2] = {{0, 1}, {0, 2}, {0, 3}, {0, 4},
+                                           {1, 2}, {1, 3}, {1, 4}, {2, 3},
+                                           {2, 4}, {3, 4}};
+    place(knights[index][1], 'N'); // the second first, it doesn't move
+    place(knights[index][0], 'N'); // the first empty file
+    place(0, 'R');
+    place(0, 'K');
+    place(0, 'R');
+
+    std::string black = rank;
+    for (char &c : black)
+      c = static_cast<char>(std::tolower(c));
+    return Board(black + "/pppppppp/8/8/8/8/PPPPPPPP/" + rank);
+  }
+
+  // Check if the square sq is attacked by a piece of color by
+  constexpr bool is_attacked(Square sq, Piece::Color by) const {
+    const auto &p = pieces[by];
+    const auto them = by == Piece::Color::WHITE ? Piece::Color::BLACK
+                                                : Piece::Color::WHITE;
+    // a pawn of color by attacks sq if a pawn of the other color on sq would
+    // attack it
+    return (Attacks::pawn(them, sq) & p[Piece::Type::PAWN]) ||
+           (Attacks::knight(sq) & p[Piece::Type::KNIGHT]) ||
+           (Attacks::king(sq) & p[Piece::Type::KING]) ||
+           (Attacks::bishop(sq, all) &
+            (p[Piece::Type::BISHOP] | p[Piece::Type::QUEEN])) ||
+           (Attacks::rook(sq, all) &
+            (p[Piece::Type::ROOK] | p[Piece::Type::QUEEN]));
   }
 
   // only modify the pieces it doesn't consider the other fields of FEN
@@ -246,14 +335,29 @@ private:
   }
 
   // Clear the board
-  constexpr void clear() {
-    for (int i = 0; i < mailbox.size(); ++i)
-      remove_piece(static_cast<Square>(i));
+  constexpr void clear() { *this = Board(); }
+
+  // Remove the piece on the squares of bits from all the bitboards, without
+  // looking for it (no branch)
+  constexpr void vacate(uint64_t bits) {
+    for (auto &color : pieces)
+      for (uint64_t &bb : color)
+        bb &= ~bits;
+    all &= ~bits;
   }
 
   // check if 2 squares are ocuppied by the same color
   constexpr bool are_in_the_same_team(Square p1, Square p2) const {
-    return get_piece_in_mailbox_at(p1).color() ==
-           get_piece_in_mailbox_at(p2).color();
+    return piece_at(p1).color() == piece_at(p2).color();
+  }
+
+  // Square bounds check, only in debug builds (make debug) since it's on the
+  // hot path of every access
+  static constexpr void check([[maybe_unused]] Square sq) {
+#ifdef DEBUG
+    assert(sq < 64);
+#endif
   }
 };
+
+static_assert(sizeof(Board) == 120);
@@ -1,8 +1,27 @@
 #pragma once
 
+#include <bit>
 #include <cstdint>
 #include <string>
 
+/*
+Castle rights with the file of the castling rook of every right, so they also
+work for Chess960 where the rooks can start on any file
+
+  | Bits  | Field                            |
+  | ----- | -------------------------------- |
+  | 0-3   | rights (see Value)               |
+  | 4-6   | file of the white kingside rook  |
+  | 7-9   | file of the white queenside rook |
+  | 10-12 | file of the black kingside rook  |
+  | 13-15 | file of the black queenside rook |
+
+The files default to h (kingside) and a (queenside), the standard position.
+to_string() is X-FEN: K/Q/k/q for a rook on the h/a file, else the file of
+the rook (Shredder-FEN letter, uppercase for white). Parsing a FEN needs the
+board to find the rooks, see GameState.
+*/
+
 class CastleRights {
 public:
   enum Value : uint8_t {
@@ -18,32 +37,26 @@ public:
   };
 
   friend constexpr CastleRights operator|(Value lhs, Value rhs) {
-    return static_cast<CastleRights>(static_cast<uint8_t>(lhs) |
-                                     static_cast<uint8_t>(rhs));
-  }
-
-  friend constexpr CastleRights operator&(Value lhs, Value rhs) {
-    return static_cast<CastleRights>(static_cast<uint8_t>(lhs) &
-                                     static_cast<uint8_t>(rhs));
+    return CastleRights(static_cast<Value>(static_cast<uint8_t>(lhs) |
+                                           static_cast<uint8_t>(rhs)));
   }
 
-  friend constexpr CastleRights operator~(Value rhs) {
-    return static_cast<CastleRights>(~static_cast<uint8_t>(rhs));
+  constexpr CastleRights() : data(DEFAULT_FILES) {}
+  constexpr explicit CastleRights(Value v) : data(DEFAULT_FILES | v) {}
+  // the rights (Value) without the rook files
+  constexpr operator uint8_t() const {
+    return static_cast<uint8_t>(data & ALL);
   }
-
-  constexpr CastleRights() : data(NONE) {}
-  constexpr explicit CastleRights(Value v) : data(v) {}
-  constexpr CastleRights(const CastleRights &v) : data(v.data) {}
-  constexpr operator uint8_t() const { return static_cast<uint8_t>(data); }
   inline operator std::string() const { return to_string(); }
-  inline explicit CastleRights(const std::string &str) {
+  // Only K, Q, k, q (the rooks on the h and a files)
+  inline explicit CastleRights(const std::string &str) : CastleRights() {
     for (auto c : str) {
       switch (c) { // clang-format off
-        case 'K': data |= WHITE_KINGSIDE; break;
-        case 'Q': data |= WHITE_QUEENSIDE; break;
-        case 'k': data |= BLACK_KINGSIDE; break;
-        case 'q': data |= BLACK_QUEENSIDE; break;
-        default:  data |= NONE; break;
+        case 'K': add(WHITE_KINGSIDE, 7); break;
+        case 'Q': add(WHITE_QUEENSIDE, 0); break;
+        case 'k': add(BLACK_KINGSIDE, 7); break;
+        case 'q': add(BLACK_QUEENSIDE, 0); break;
+        default:  break;
       } // clang-format on
     }
   }
@@ -56,24 +69,65 @@ public:
     return CastleRights(str);
   }
 
-  // to_strin
+  // Same rights with the same rooks (the files of the rights not owned are
+  // not compared)
+  constexpr bool operator==(const CastleRights &c) const {
+    if ((data & ALL) != (c.data & ALL))
+      return false;
+    for (int i = 0; i < 4; ++i)
+      if ((data >> i & 1) && rook_file(side(i)) != c.rook_file(side(i)))
+        return false;
+    return true;
+  }
+
+  constexpr bool has(Value right) const { return data & right; }
+
+  // File of the castling rook of a single right
+  constexpr int rook_file(Value right) const {
+    return data >> shift(right) & 7;
+  }
+
+  // Add a single right with the file of its rook
+  constexpr void add(Value right, int file) {
+    data = static_cast<uint16_t>((data & ~(7 << shift(right))) |
+                                 (file & 7) << shift(right) | right);
+  }
+
+  // Remove the rights (any combination of Value)
+  constexpr void remove(uint8_t rights) {
+    data = static_cast<uint16_t>(data & ~(rights & ALL));
+  }
+
+  // to_string (X-FEN)
   inline std::string to_string() const {
     std::string str;
-    if (data & WHITE_KINGSIDE)
-      str += 'K';
-    if (data & WHITE_QUEENSIDE)
-      str += 'Q';
-    if (data & BLACK_KINGSIDE)
-      str += 'k';
-    if (data & BLACK_QUEENSIDE)
-      str += 'q';
+    for (int i = 0; i < 4; ++i) {
+      const Value right = side(i);
+      if (!has(right))
+        continue;
+      const int file = rook_file(right);
+      const bool white = i < 2;
+      if (file == (i % 2 == 0 ? 7 : 0)) // h or a file
+        str += "KQkq"[i];
+      else
+        str += static_cast<char>((white ? 'A' : 'a') + file);
+    }
     if (str.empty())
       str += '-';
     return str;
   }
 
 private:
-  uint8_t data; // 1 byte
+  uint16_t data; // 2 bytes
+
+  // h file for the kingside rooks, a file for the queenside rooks
+  static constexpr uint16_t DEFAULT_FILES = 7 << 4 | 7 << 10;
 
-  constexpr explicit CastleRights(uint8_t v) : data(v) {}
+  // the i-th right: WHITE_KINGSIDE, WHITE_QUEENSIDE, BLACK_KINGSIDE, ...
+  static constexpr Value side(int i) { return static_cast<Value>(1 << i); }
+
+  // first bit of the rook file of a single right
+  static constexpr int shift(Value right) {
+    return 4 + 3 * std::countr_zero(static_cast<unsigned>(right));
+  }
 };
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <map>
+#include <stdexcept>
+#include <string>
+
+// Command line options of the form: --name value --flag
+// example: tiresia analyse --input positions.epd --depth 8 --threads 4
+class Args {
+public:
+  // first is the index of the first option (after the mode name)
+  inline Args(int argc, char **argv, int first = 2) {
+    for (int i = first; i < argc; ++i) {
+      std::string name = argv[i];
+      if (name.rfind("--", 0) != 0)
+        throw std::runtime_error("Invalid option: " + name);
+      name = name.substr(2);
+      // a flag has no value
+      if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0)
+        options[name] = argv[++i];
+      else
+        options[name] = "true";
+    }
+  }
+
+  inline bool has(const std::string &name) const {
+    return options.contains(name);
+  }
+
+  inline std::string get(const std::string &name,
+                         const std::string &def = "") const {
+    auto it = options.find(name);
+    return it == options.end() ? def : it->second;
+  }
+
+  inline long long get_int(const std::string &name, long long def) const {
+    auto it = options.find(name);
+    if (it == options.end())
+      return def;
+    try {
+      return std::stoll(it->second);
+    } catch (const std::exception &) {
+      throw std::runtime_error("Invalid value for --" + name + ": " +
+                               it->second);
+    }
+  }
+
+private:
+  std::map<std::string, std::string> options;
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "packed.hpp"
+
+/*
+Binary file of scored positions (training data)
+
+  | Header  | "TIRD" magic (4 bytes) + version (4 bytes)          |
+  | Chunk 0 | "CHNK" magic (4 bytes) + count (4 bytes) + records |
+  | Chunk 1 | ...                                                 |
+
+Every record is a PackedPosition (32 bytes) with its score and the result of
+the game set, both from the point of view of the side to move.
+A chunk holds at most CHUNK_RECORDS records and is always written with a
+single write, so many threads can append to the same file without mixing
+their records, and a reader can split the work by chunk.
+The file is little endian and it is read by mapping it in memory.
+*/
+
+using DataRecord = PackedPosition;
+
+class DataFile {
+public:
+  static constexpr char MAGIC[4] = {'T', 'I', 'R', 'D'};
+  static constexpr char CHUNK_MAGIC[4] = {'C', 'H', 'N', 'K'};
+  static constexpr uint32_t VERSION = 2; // 2: castling rooks in the pieces
+  static constexpr uint32_t CHUNK_RECORDS = 1 << 16;
+
+  struct Header {
+    char magic[4];
+    uint32_t version;
+  };
+
+  struct ChunkHeader {
+    char magic[4];
+    uint32_t count;
+  };
+};
+
+// Append records to a data file
+// write() is buffered and not thread safe, write_chunk() is thread safe so
+// each thread can fill its own buffer and append it as a whole
+class DataWriter {
+public:
+  inline explicit DataWriter(const std::string &path, bool append = false)
+      : file(std::fopen(path.c_str(), append ? "ab" : "wb")) {
+    if (!file)
+      throw std::runtime_error("DataWriter: cannot open " + path);
+    std::fseek(file, 0, SEEK_END);
+    if (std::ftell(file) == 0) {
+      DataFile::Header h{};
+      std::memcpy(h.magic, DataFile::MAGIC, 4);
+      h.version = DataFile::VERSION;
+      write_raw(&h, sizeof(h));
+    }
+    buffer.reserve(DataFile::CHUNK_RECORDS);
+  }
+
+  inline ~DataWriter() {
+    try {
+      flush();
+    } catch (...) {
+    }
+    std::fclose(file);
+  }
+
+  DataWriter(const DataWriter &) = delete;
+  DataWriter &operator=(const DataWriter &) = delete;
+
+  inline void write(const DataRecord &r) {
+    buffer.push_back(r);
+    if (buffer.size() == DataFile::CHUNK_RECORDS)
+      flush();
+  }
+
+  inline void flush() {
+    write_chunk(buffer);
+    buffer.clear();
+    std::lock_guard lock(mutex);
+    std::fflush(file);
+  }
+
+  // Append the records (split in chunks if they are too many)
+  inline void write_chunk(std::span<const DataRecord> records) {
+    while (!records.empty()) {
+      const auto n = std::min<std::size_t>(records.size(),
+                                           DataFile::CHUNK_RECORDS);
+      DataFile::ChunkHeader h{};
+      std::memcpy(h.magic, DataFile::CHUNK_MAGIC, 4);
+      h.count = static_cast<uint32_t>(n);
+
+      std::lock_guard lock(mutex);
+      write_raw(&h, sizeof(h));
+      write_raw(records.data(), n * sizeof(DataRecord));
+      records = records.subspan(n);
+    }
+  }
+
+private:
+  std::FILE *file;
+  std::mutex mutex;
+  std::vector<DataRecord> buffer;
+
+  inline void write_raw(const void *data, std::size_t bytes) {
+    if (std::fwrite(data, 1, bytes, file) != bytes)
+      throw std::runtime_error("DataWriter: write failed");
+  }
+};
+
+// Read only view of a data file mapped in memory
+class DataReader {
+public:
+  inline explicit DataReader(const std::string &path) {
+#if defined(__linux__) || defined(__APPLE__)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("DataReader: cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::runtime_error("DataReader: cannot stat " + path);
+    }
+    _bytes = static_cast<std::size_t>(st.st_size);
+    if (_bytes > 0) {
+      void *mem = mmap(nullptr, _bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mem == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("DataReader: cannot map " + path);
+      }
+      madvise(mem, _bytes, MADV_SEQUENTIAL);
+      _data = static_cast<const char *>(mem);
+    }
+    ::close(fd);
+#else
+#error "DataReader needs mmap"
+#endif
+    index();
+  }
+
+  inline ~DataReader() {
+    if (_data)
+      munmap(const_cast<char *>(_data), _bytes);
+  }
+
+  DataReader(const DataReader &) = delete;
+  DataReader &operator=(const DataReader &) = delete;
+
+  constexpr std::size_t chunks() const { return _chunks.size(); }
+  constexpr std::size_t size() const { return _size; }
+
+  // Records of the i-th chunk
+  inline std::span<const DataRecord> chunk(std::size_t i) const {
+    return _chunks[i];
+  }
+
+  // Call f(record) on every record in file order
+  template <typename F> inline void for_each(F f) const {
+    for (const auto &c : _chunks)
+      for (const DataRecord &r : c)
+        f(r);
+  }
+
+private:
+  const char *_data = nullptr;
+  std::size_t _bytes = 0;
+  std::size_t _size = 0; // number of records
+  std::vector<std::span<const DataRecord>> _chunks;
+
+  // Check the header and find the chunks
+  inline void index() {
+    DataFile::Header h;
+    if (_bytes < sizeof(h))
+      throw std::runtime_error("DataReader: file too short");
+    std::memcpy(&h, _data, sizeof(h));
+    if (std::memcmp(h.magic, DataFile::MAGIC, 4) != 0 ||
+        h.version != DataFile::VERSION)
+      throw std::runtime_error("DataReader: not a data file");
+
+    std::size_t offset = sizeof(h);
+    while (offset < _bytes) {
+      DataFile::ChunkHeader c;
+      if (_bytes - offset < sizeof(c))
+        throw std::runtime_error("DataReader: truncated chunk");
+      std::memcpy(&c, _data + offset, sizeof(c));
+      offset += sizeof(c);
+      const std::size_t bytes = std::size_t(c.count) * sizeof(DataRecord);
+      if (std::memcmp(c.magic, DataFile::CHUNK_MAGIC, 4) != 0 ||
+          _bytes - offset < bytes)
+        throw std::runtime_error("DataReader: truncated chunk");
+      // header and records are 8 bytes, so every record is aligned
+      _chunks.emplace_back(
+          reinterpret_cast<const DataRecord *>(_data + offset), c.count);
+      _size += c.count;
+      offset += bytes;
+    }
+  }
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cli.hpp"
+#include "datafile.hpp"
+#include "gamestate.hpp"
+#include "packed.hpp"
+#include "search.hpp"
+#include "threadpool.hpp"
+#include "zobrist.hpp"
+
+/*
+Self-play training data generator
+
+  tiresia datagen --output data.bin [--games N] [--threads T] [--nodes N]
+                  [--depth N] [--seed S] [--max-plies N] [--max-score CP]
+                  [--params params.txt] [--random-plies N]
+                  [--pin]
+
+Every worker plays its games alone: it has its own Searcher, random generator
+and buffer, the only shared state is the counter of the games and the output
+file, that is locked once per chunk (DataFile::CHUNK_RECORDS positions).
+
+The games start from a random Chess960 position followed by random-plies
+random legal moves (not recorded), without them the fixed node search would
+play the same games again from the same start positions. A position is kept
+only if it is quiet: the side to move is not in check and the best move is
+not a capture or a promotion. A game ends with a checkmate, a stalemate, the 50
+moves rule, a threefold repetition or after maxPlies (draw). When the game
+ends every kept position gets the result from the point of view of its side
+to move.
+*/
+
+class Datagen {
+public:
+  struct Options {
+    std::string output;
+    uint64_t games = 1000;
+    std::size_t threads = ThreadPool::default_threads();
+    SearchLimits limits{.nodes = 5000}; // fixed nodes
+    uint64_t seed = 0;
+    int maxPlies = 400;  // adjudicated draw after maxPlies
+    int maxScore = 3000; // positions with a bigger score are not kept
+    int randomPlies = 8; // random moves of the opening
+    bool pin = false;
+  };
+
+  struct Stats {
+    uint64_t games = 0;
+    uint64_t positions = 0;
+  };
+
+  static inline Options options(const Args &args) {
+    Options opt;
+    opt.output = args.get("output");
+    if (opt.output.empty())
+      throw std::runtime_error("datagen: missing --output");
+    opt.games = args.get_int("games", opt.games);
+    opt.threads = args.get_int("threads", opt.threads);
+    opt.limits.depth = args.get_int("depth", opt.limits.depth);
+    opt.limits.nodes = args.get_int("nodes", opt.limits.nodes);
+    if (args.has("params"))
+      opt.limits.params = std::make_shared<const EvalParams>(
+          EvalParams::load(args.get("params")));
+    opt.seed = args.get_int("seed", std::random_device{}());
+    opt.maxPlies = args.get_int("max-plies", opt.maxPlies);
+    opt.maxScore = args.get_int("max-score", opt.maxScore);
+    opt.randomPlies = args.get_int("random-plies", opt.randomPlies);
+    opt.pin = args.has("pin");
+    return opt;
+  }
+
+  static inline int run(const Args &args) {
+    const Options opt = options(args);
+    const auto start = std::chrono::steady_clock::now();
+    const Stats stats = run(opt);
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    std::fprintf(stderr, "datagen: %llu games, %llu positions in %.1f s\n",
+                 static_cast<unsigned long long>(stats.games),
+                 static_cast<unsigned long long>(stats.positions), seconds);
+    return 0;
+  }
+
+  static inline Stats run(const Options &opt) {
+    DataWriter writer(opt.output);
+    std::atomic<uint64_t> next = 0, positions = 0;
+
+    {
+      ThreadPool pool(opt.threads, opt.pin);
+      for (std::size_t i = 0; i < pool.size(); ++i)
+        pool.submit([&, i](std::size_t) {
+          Worker worker(opt, i);
+          while (next.fetch_add(1, std::memory_order_relaxed) < opt.games) {
+            worker.play();
+            if (worker.buffer.size() >= DataFile::CHUNK_RECORDS)
+              worker.flush(writer);
+          }
+          positions += worker.positions;
+          worker.flush(writer);
+        });
+    }
+
+    return Stats{opt.games, positions};
+  }
+
+private:
+  struct Worker {
+    const Options &opt;
+    Searcher searcher;
+    std::mt19937_64 rng;
+    std::vector<PackedPosition> buffer; // positions of the finished games
+    std::vector<PackedPosition> game;   // positions of the current game
+    std::vector<uint64_t> keys;         // keys of the current game
+    uint64_t positions = 0;
+
+    inline Worker(const Options &opt, std::size_t index)
+        : opt(opt), rng(opt.seed + index * 0x9E3779B97F4A7C15ULL) {
+      buffer.reserve(DataFile::CHUNK_RECORDS + opt.maxPlies);
+      game.reserve(opt.maxPlies);
+    }
+
+    // A random Chess960 start and opt.randomPlies random legal moves (again
+    // if the moves end the game)
+    inline GameState opening() {
+      while (true) {
+        GameState gs = GameState::init_960(static_cast<int>(rng() % 960));
+        for (int ply = 0; ply <= opt.randomPlies; ++ply) {
+          const MoveList moves = MoveGen::legal_moves(gs);
+          if (moves.empty())
+            break;
+          if (ply == opt.randomPlies)
+            return gs;
+          gs.make_move(moves[static_cast<int>(rng() % moves.size())]);
+        }
+      }
+    }
+
+    inline void play() {
+      GameState gs = opening();
+      game.clear();
+      keys.clear();
+
+      // result of the game from the point of view of white
+      PackedPosition::Result result = PackedPosition::DRAW;
+      for (int ply = 0; ply < opt.maxPlies; ++ply) {
+        // the positions since the last capture or pawn move can repeat
+        keys.push_back(Zobrist::hash(gs));
+        const std::size_t reversible =
+            std::min<std::size_t>(keys.size(), gs.halfMoveClock() + 1);
+        if (std::count(keys.end() - reversible, keys.end(), keys.back()) >= 3)
+          break; // threefold repetition
+
+        const SearchResult r = searcher.search(gs, opt.limits);
+        if (!r.bestMove) { // checkmate or stalemate
+          if (gs.in_check())
+            result = gs.turn() == Piece::Color::WHITE ? PackedPosition::LOSS
+                                                      : PackedPosition::WIN;
+          break;
+        }
+        if (gs.halfMoveClock() >= 100)
+          break; // 50 moves rule
+
+        if (std::abs(r.score) <= opt.maxScore && !gs.in_check() &&
+            is_quiet(gs, *r.bestMove)) {
+          PackedPosition p(gs);
+          p.set_score(static_cast<int16_t>(std::clamp(
+              r.score, int(std::numeric_limits<int16_t>::min()),
+              int(std::numeric_limits<int16_t>::max()))));
+          game.push_back(p);
+        }
+        gs.make_move(*r.bestMove);
+      }
+
+      for (PackedPosition &p : game) {
+        p.set_result(p.turn() == Piece::Color::WHITE
+                         ? result
+                         : static_cast<PackedPosition::Result>(-result));
+        buffer.push_back(p);
+      }
+      positions += game.size();
+    }
+
+    inline void flush(DataWriter &writer) {
+      writer.write_chunk(buffer);
+      buffer.clear();
+    }
+  };
+
+  // The best move is not a capture or a promotion
+  static inline bool is_quiet(const GameState &gs, const Move &m) {
+    switch (m.type()) {
+    case Move::Type::CASTLING:
+      return true;
+    case Move::Type::EN_PASSANT:
+    case Move::Type::PROMOTION_KNIGHT:
+    case Move::Type::PROMOTION_BISHOP:
+    case Move::Type::PROMOTION_ROOK:
+    case Move::Type::PROMOTION_QUEEN:
+      return false;
+    default:
+      return !gs.board().piece_at(m.to());
+    }
+  }
+};
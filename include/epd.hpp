@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cctype>
+#include <istream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "gamestate.hpp"
+
+/*
+EPD (Extended Position Description) record
+ref: https://www.chessprogramming.org/Extended_Position_Description
+
+The first 4 fields are the same of a FEN (position, turn, castle rights, en
+passant square) followed by the operations "opcode operands;"
+
+  rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 id "e4"; hmvc 0;
+
+A full FEN (6 fields) is accepted too, so the same reader works on FEN files
+*/
+
+class Epd {
+public:
+  std::string position;   // the 4 FEN fields
+  std::string operations; // everything after the 4 FEN fields
+  int halfMoveClock = 0;
+  int fullMoveNumber = 1;
+
+  inline explicit Epd(const std::string &line) {
+    std::istringstream in(line);
+    std::string fields[4];
+    for (auto &f : fields)
+      if (!(in >> f))
+        throw std::runtime_error("Invalid EPD: missing fields");
+    position = fields[0] + ' ' + fields[1] + ' ' + fields[2] + ' ' + fields[3];
+
+    std::getline(in >> std::ws, operations);
+
+    // full FEN: the clocks are the 2 numbers after the 4 fields
+    std::istringstream rest(operations);
+    std::string half, full;
+    if (rest >> half >> full && is_number(half) && is_number(full)) {
+      halfMoveClock = std::stoi(half);
+      fullMoveNumber = std::stoi(full);
+      std::getline(rest >> std::ws, operations);
+      return;
+    }
+
+    const std::string hmvc = operation("hmvc");
+    const std::string fmvn = operation("fmvn");
+    if (is_number(hmvc))
+      halfMoveClock = std::stoi(hmvc);
+    if (is_number(fmvn))
+      fullMoveNumber = std::stoi(fmvn);
+  }
+
+  // Full FEN (6 fields) of the record
+  inline std::string fen() const {
+    return position + ' ' + std::to_string(halfMoveClock) + ' ' +
+           std::to_string(fullMoveNumber);
+  }
+
+  inline GameState gamestate() const { return GameState(fen()); }
+
+  // Operands of the first operation with the given opcode ("" if not present)
+  // example: operation("id") of 'bm e4; id "test 1";' is '"test 1"'
+  inline std::string operation(const std::string &opcode) const {
+    std::size_t start = 0;
+    while (start < operations.size()) {
+      std::size_t end = find_end(start);
+      std::string op = trim(operations.substr(start, end - start));
+      std::size_t space = op.find(' ');
+      if (op.substr(0, space) == opcode)
+        return space == std::string::npos ? "" : trim(op.substr(space + 1));
+      start = end + 1;
+    }
+    return {};
+  }
+
+  // Skip empty lines and comments
+  static inline bool is_record(const std::string &line) {
+    std::size_t i = line.find_first_not_of(" \t\r");
+    return i != std::string::npos && line[i] != '#';
+  }
+
+private:
+  // end of the operation starting at start (';' not inside a string)
+  inline std::size_t find_end(std::size_t start) const {
+    bool quoted = false;
+    for (std::size_t i = start; i < operations.size(); ++i) {
+      if (operations[i] == '"')
+        quoted = !quoted;
+      else if (operations[i] == ';' && !quoted)
+        return i;
+    }
+    return operations.size();
+  }
+
+  static inline std::string trim(const std::string &s) {
+    std::size_t b = s.find_first_not_of(" \t\r");
+    std::size_t e = s.find_last_not_of(" \t\r");
+    return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+  }
+
+  static inline bool is_number(const std::string &s) {
+    if (s.empty())
+      return false;
+    for (char c : s)
+      if (!std::isdigit(static_cast<unsigned char>(c)))
+        return false;
+    return true;
+  }
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "board.hpp"
+#include "gamestate.hpp"
+#include "piece.hpp"
+
+// Parameters of the evaluation, they can be tuned with `tiresia tune`
+struct EvalParams {
+  // centipawns, by Piece::Type
+  std::array<int, Piece::Type::PIECE_NB> pieceValue;
+  // piece square tables, by Piece::Type, from the white point of view
+  // (a1 = 0, see move.hpp), for black the square is mirrored (sq ^ 56)
+  std::array<std::array<int, 64>, Piece::Type::PIECE_NB> pst;
+
+  // Piece::value() and no piece square tables
+  static constexpr EvalParams defaults() {
+    EvalParams p{};
+    for (int t = Piece::Type::PAWN; t < Piece::Type::PIECE_NB; ++t)
+      p.pieceValue[t] =
+          Piece(Piece::Color::WHITE, static_cast<Piece::Type>(t)).value() *
+          100; // pawn = 100 centipawns
+    return p;
+  }
+
+  /*
+  Text file of the parameters, written by `tiresia tune` and read with
+  --params, '#' starts a comment and the values are separated by spaces:
+
+    value 0 100 300 300 500 900 0   # by Piece::Type
+    pst N                            # 64 values, a1 b1 ... h1 a2 ... h8
+      0 0 0 0 0 0 0 0
+      ...
+
+  The parameters missing from the file keep their default value.
+  */
+  static inline EvalParams load(const std::string &path) {
+    std::ifstream in(path);
+    if (!in)
+      throw std::runtime_error("EvalParams: cannot open " + path);
+    std::stringstream text;
+    for (std::string line; std::getline(in, line);)
+      text << line.substr(0, line.find('#')) << '\n';
+
+    EvalParams p = defaults();
+    const auto values = [&](auto &array, const std::string &name) {
+      for (auto &v : array)
+        if (!(text >> v))
+          throw std::runtime_error("EvalParams: " + path +
+                                   ": missing values of " + name);
+    };
+    for (std::string key; text >> key;) {
+      if (key == "value") {
+        values(p.pieceValue, key);
+      } else if (key == "pst") {
+        std::string letter;
+        text >> letter;
+        const Piece piece =
+            Piece::from(letter.size() == 1 ? letter[0] : '?');
+        if (piece.type() == Piece::Type::NO_PIECE)
+          throw std::runtime_error("EvalParams: " + path +
+                                   ": invalid piece " + letter);
+        values(p.pst[piece.type()], key + ' ' + letter);
+      } else {
+        throw std::runtime_error("EvalParams: " + path + ": unknown " + key);
+      }
+    }
+    return p;
+  }
+
+  // Write the parameters in the format of load()
+  inline void save(std::FILE *out) const {
+    std::fprintf(out, "value");
+    for (int v : pieceValue)
+      std::fprintf(out, " %d", v);
+    std::fprintf(out, "\n");
+    for (int t = Piece::Type::PAWN; t < Piece::Type::PIECE_NB; ++t) {
+      std::fprintf(out, "pst %c\n",
+                   Piece(Piece::Color::WHITE, static_cast<Piece::Type>(t))
+                       .to_letter());
+      for (int rank = 0; rank < 8; ++rank) {
+        for (int file = 0; file < 8; ++file)
+          std::fprintf(out, " %4d", pst[t][rank * 8 + file]);
+        std::fprintf(out, "   # rank %d\n", rank + 1);
+      }
+    }
+  }
+
+  constexpr bool operator==(const EvalParams &) const = default;
+};
+
+// Static evaluation of a position
+// the score is in centipawns from the point of view of the side to move
+class Eval {
+public:
+  static constexpr int PAWN_VALUE = 100; // centipawns
+  static constexpr EvalParams DEFAULT_PARAMS = EvalParams::defaults();
+
+  // Material and piece square tables, from the white point of view
+  static inline int material(const Board &b,
+                             const EvalParams &params = DEFAULT_PARAMS) {
+    int score = 0;
+    for (int t = Piece::Type::PAWN; t < Piece::Type::PIECE_NB; ++t) {
+      const auto type = static_cast<Piece::Type>(t);
+      for (uint64_t bb = b.bitboard(Piece::Color::WHITE, type); bb;
+           bb &= bb - 1)
+        score += params.pieceValue[t] + params.pst[t][std::countr_zero(bb)];
+      for (uint64_t bb = b.bitboard(Piece::Color::BLACK, type); bb;
+           bb &= bb - 1)
+        score -=
+            params.pieceValue[t] + params.pst[t][std::countr_zero(bb) ^ 56];
+    }
+    return score;
+  }
+
+  static inline int evaluate(const GameState &gs,
+                             const EvalParams &params = DEFAULT_PARAMS) {
+    const int score = material(gs.board(), params);
+    return gs.turn() == Piece::Color::WHITE ? score : -score;
+  }
+};
@@ -1,13 +1,21 @@
 #pragma once
 
+#include <bit>
+#include <cctype>
+#include <cstdlib>
+#include <regex>
+#include <string>
+
 #include "board.hpp"
 #include "castle.hpp"
 #include "move.hpp"
 #include "piece.hpp"
 
-class GameState {
+// aligned to a cache line: a copy of the whole state (the search copies it
+// at every move) touches exactly 2 cache lines
+class alignas(64) GameState {
 private:
-  Board board; // 176 bytes
+  Board _board; // 120 bytes
 
   // half move = move for 1 player
   // // count of moves without a capture or pawn move (in
@@ -16,7 +24,7 @@ private:
 
   // full move = move for both players
   uint16_t _fullMoveNumber;   // 2 bytes
-  CastleRights _castleRights; // 1 byte
+  CastleRights _castleRights; // 2 bytes
   Square _enPassantSquare;    // 1 byte
   Piece::Color _turn;         // 1 byte
 
@@ -30,9 +38,9 @@ public:
     if (!match)
       throw std::runtime_error("Invalid FEN");
 
-    board = Board((*match)[1].str());
+    _board = Board((*match)[1].str());
     _turn = (*match)[2] == "w" ? Piece::Color::WHITE : Piece::Color::BLACK;
-    _castleRights = CastleRights::from((*match)[3].str());
+    _castleRights = castle_rights((*match)[3].str(), _board);
     _enPassantSquare =
         (*match)[4] == "-"
             ? Square::NONE                     // no en passant
@@ -41,10 +49,65 @@ public:
     _fullMoveNumber = std::stoi((*match)[6].str());
   }
 
+  // Constructor from the single fields
+  inline GameState(const Board &board, Piece::Color turn,
+                   CastleRights castleRights,
+                   Square enPassantSquare = Square::from(Square::NONE),
+                   uint16_t halfMoveClock = 0, uint16_t fullMoveNumber = 1)
+      : _board(board), _halfMoveClock(halfMoveClock),
+        _fullMoveNumber(fullMoveNumber), _castleRights(castleRights),
+        _enPassantSquare(enPassantSquare), _turn(turn) {}
+
   static inline GameState init_std() { return GameState(); }
-  static inline GameState init_960() {
-    return GameState(
-        "nqrkrbbn/pppppppp/8/8/8/8/PPPPPPPP/NQRKRBBN w KQkq - 0 1");
+  // Chess960 start position with the Scharnagl index (see Board::init_960)
+  static inline GameState init_960(int index) {
+    const Board board = Board::init_960(index);
+    return GameState(board, Piece::Color::WHITE, castle_rights("KQkq", board));
+  }
+
+  // Castle rights of a FEN with the rooks found on the board: K/Q/k/q is the
+  // outermost rook on that side of the king (X-FEN), A-H/a-h the rook on that
+  // file (Shredder-FEN). The rights without their king or rook on the first
+  // rank are dropped.
+  static inline CastleRights castle_rights(const std::string &str,
+                                           const Board &board) {
+    CastleRights rights = CastleRights::none();
+    for (const char c : str) {
+      if (c == '-')
+        continue;
+      const bool white = std::isupper(static_cast<unsigned char>(c));
+      const auto color = white ? Piece::Color::WHITE : Piece::Color::BLACK;
+      const uint64_t rank = white ? 0xFFULL : 0xFFULL << 56;
+      const uint64_t king = board.bitboard(color, Piece::Type::KING) & rank;
+      const uint64_t rooks = board.bitboard(color, Piece::Type::ROOK) & rank;
+      if (!king)
+        continue;
+      const int kingFile = std::countr_zero(king) % 8;
+      // rooks as files (bit f = rook on file f)
+      const unsigned files = static_cast<unsigned>(
+          (white ? rooks : rooks >> 56) & 0xFF);
+      const unsigned right = files & ~((2u << kingFile) - 1); // after the king
+      const unsigned left = files & ((1u << kingFile) - 1);   // before it
+
+      const char lower = static_cast<char>(std::tolower(c));
+      int file;
+      if (lower == 'k' && right)
+        file = std::bit_width(right) - 1; // outermost
+      else if (lower == 'q' && left)
+        file = std::countr_zero(left);
+      else if (lower >= 'a' && lower <= 'h' && (files >> (lower - 'a') & 1))
+        file = lower - 'a';
+      else
+        continue;
+
+      const bool kingside = file > kingFile;
+      rights.add(white ? (kingside ? CastleRights::WHITE_KINGSIDE
+                                   : CastleRights::WHITE_QUEENSIDE)
+                       : (kingside ? CastleRights::BLACK_KINGSIDE
+                                   : CastleRights::BLACK_QUEENSIDE),
+                 file);
+    }
+    return rights;
   }
 
 private:
@@ -61,7 +124,7 @@ private:
     static const std::regex fen_regex(
         R"(^((?:[pnbrqkPNBRQK1-8]+/){7}[pnbrqkPNBRQK1-8]+)\s)" // posizione
         R"((w|b)\s)"                                           // turno
-        R"((-|K?Q?k?q?)\s)"                                    // arrocco
+        R"((-|[KQkqA-Ha-h]{1,4})\s)"                           // arrocco
         R"((-|[a-h][36])\s)"                                   // en passant
         R"((\d+)\s(\d+)$)" // half move and full move
     );
@@ -103,13 +166,172 @@ private:
   }
 
 public:
+  constexpr bool operator==(const GameState &gs) const {
+    return _board == gs._board && _halfMoveClock == gs._halfMoveClock &&
+           _fullMoveNumber == gs._fullMoveNumber &&
+           _castleRights == gs._castleRights &&
+           uint8_t(_enPassantSquare) == uint8_t(gs._enPassantSquare) &&
+           _turn == gs._turn;
+  }
+
   // Getters
+  constexpr const Board &board() const { return _board; }
   constexpr uint16_t halfMoveClock() const { return _halfMoveClock; }
   constexpr uint16_t fullMoveNumber() const { return _fullMoveNumber; }
   constexpr CastleRights castleRights() const { return _castleRights; }
   constexpr Square enPassantSquare() const { return _enPassantSquare; }
   constexpr Piece::Color turn() const { return _turn; }
 
+  // Check if the king of the side to move is attacked
+  inline bool in_check() const {
+    const uint64_t king = _board.bitboard(_turn, Piece::Type::KING);
+    if (!king)
+      return false;
+    return _board.is_attacked(static_cast<uint8_t>(std::countr_zero(king)),
+                              opponent());
+  }
+
+  constexpr Piece::Color opponent() const {
+    return _turn == Piece::Color::WHITE ? Piece::Color::BLACK
+                                        : Piece::Color::WHITE;
+  }
+
+  // Move from UCI notation (e2e4, e7e8q, e1g1 or e1h1 for castling), the
+  // type of the move is deduced from the position (the move is not checked
+  // to be legal)
+  inline Move move_from_uci(const std::string &uci) const {
+    static const std::regex uci_regex(
+        R"(^([a-h][1-8])([a-h][1-8])([nbrq]?)$)"); // from, to, promotion
+    std::smatch match;
+    if (!std::regex_match(uci, match, uci_regex))
+      throw std::runtime_error("Invalid move: " + uci);
+
+    const Square from = Square::from(match[1].str());
+    Square to = Square::from(match[2].str());
+    const Piece p = _board.piece_at(from);
+    const Piece target = _board.piece_at(to);
+    if (!p || p.color() != _turn)
+      throw std::runtime_error("Invalid move: " + uci);
+
+    const int fileFrom = from % 8, fileTo = to % 8;
+    const int rankFrom = from / 8, rankTo = to / 8;
+
+    if (match[3].length()) { // clang-format off
+      switch (match[3].str()[0]) {
+      case 'n': return Move(from, to, Move::Type::PROMOTION_KNIGHT);
+      case 'b': return Move(from, to, Move::Type::PROMOTION_BISHOP);
+      case 'r': return Move(from, to, Move::Type::PROMOTION_ROOK);
+      default:  return Move(from, to, Move::Type::PROMOTION_QUEEN);
+      } // clang-format on
+    }
+
+    if (p.is_king()) {
+      // Chess960 notation: the king moves on its own rook
+      if (target.is_rook() && target.color() == _turn)
+        return Move(from, to, Move::Type::CASTLING);
+      // standard notation: the king moves 2 files, the rook is the one of
+      // the castle right on that side
+      if (rankFrom == rankTo && std::abs(fileTo - fileFrom) == 2) {
+        const bool white = _turn == Piece::Color::WHITE;
+        const auto right =
+            fileTo > fileFrom
+                ? (white ? CastleRights::WHITE_KINGSIDE
+                         : CastleRights::BLACK_KINGSIDE)
+                : (white ? CastleRights::WHITE_QUEENSIDE
+                         : CastleRights::BLACK_QUEENSIDE);
+        if (_castleRights.has(right))
+          return Move(from,
+                      static_cast<uint8_t>(rankFrom * 8 +
+                                           _castleRights.rook_file(right)),
+                      Move::Type::CASTLING);
+      }
+    }
+
+    if (p.is_pawn()) {
+      if (std::abs(rankTo - rankFrom) == 2)
+        return Move(from, to, Move::Type::DOUBLE_PAWN_PUSH);
+      if (fileFrom != fileTo && !target)
+        return Move(from, to, Move::Type::EN_PASSANT);
+    }
+
+    return Move(from, to);
+  }
+
+  // Play a move and update all the fields (the move is not checked to be
+  // legal)
+  // Note: a castling move is encoded as the king moving on its own rook (it
+  // works also for Chess960), the king goes to the g/c file and the rook to
+  // the f/d file
+  inline void make_move(const Move &move) {
+    const Square from = move.from(), to = move.to();
+    const Piece p = _board.piece_at(from);
+    const Piece captured = _board.piece_at(to);
+    const uint8_t rank = from / 8 * 8; // first square of the rank of from
+
+    _enPassantSquare = Square::from(Square::NONE);
+    ++_halfMoveClock;
+
+    // null move: the side to move passes (only used by the search)
+    if (move == Move::Type::BULL_MOVE) {
+      if (_turn == Piece::Color::BLACK)
+        ++_fullMoveNumber;
+      _turn = opponent();
+      return;
+    }
+
+    switch (move.type()) {
+    case Move::Type::CASTLING: {
+      const bool kingside = to > from;
+      _board.remove_piece(from);
+      _board.remove_piece(to);
+      _board.set_piece(rank + (kingside ? Square::G1 : Square::C1), p);
+      _board.set_piece(rank + (kingside ? Square::F1 : Square::D1), captured);
+      break;
+    }
+    case Move::Type::EN_PASSANT:
+      _board.remove_piece(_turn == Piece::Color::WHITE ? to - 8 : to + 8);
+      _board.move_piece(from, to);
+      break;
+    case Move::Type::PROMOTION_KNIGHT:
+    case Move::Type::PROMOTION_BISHOP:
+    case Move::Type::PROMOTION_ROOK:
+    case Move::Type::PROMOTION_QUEEN:
+      _board.remove_piece(from);
+      // promotion type = piece type (see Move::Type)
+      _board.set_piece(to, Piece(_turn, static_cast<Piece::Type>(move.type())));
+      break;
+    case Move::Type::DOUBLE_PAWN_PUSH:
+      _board.move_piece(from, to);
+      _enPassantSquare = static_cast<uint8_t>((from + to) / 2);
+      break;
+    default:
+      _board.move_piece(from, to); // captures the piece on to
+      break;
+    }
+
+    if (p.is_pawn() || (captured && move != Move::Type::CASTLING))
+      _halfMoveClock = 0;
+
+    // castle rights are lost when the king moves or when a castling rook
+    // leaves (or is captured on) its square
+    if (_castleRights) {
+      if (p.is_king())
+        _castleRights.remove(_turn == Piece::Color::WHITE
+                                 ? CastleRights::WHITE_CASTLING
+                                 : CastleRights::BLACK_CASTLING);
+      for (int i = 0; i < 4; ++i) {
+        const auto right = static_cast<CastleRights::Value>(1 << i);
+        const int rook = (i < 2 ? 0 : 56) + _castleRights.rook_file(right);
+        if (_castleRights.has(right) && (from == rook || to == rook))
+          _castleRights.remove(right);
+      }
+    }
+
+    if (_turn == Piece::Color::BLACK)
+      ++_fullMoveNumber;
+    _turn = opponent();
+  }
+
   inline void state() {
     static std::size_t i = 1;
     std::printf("GameState %zu\n", i++);
@@ -122,13 +344,17 @@ public:
     std::printf("Half move clock:   %15d\n", _halfMoveClock);
     std::printf("Full move number:  %15d\n", _fullMoveNumber);
   }
-  inline void print_board() { board.print(Board::get_utf8_piece); }
-  constexpr void remove_piece(Square sq) { board.remove_piece(sq); }
-  constexpr void move_piece(const Move &move) { move_piece(move); }
+  inline void print_board() { _board.print(Board::get_utf8_piece); }
+  constexpr void remove_piece(Square sq) { _board.remove_piece(sq); }
+  constexpr void move_piece(const Move &move) {
+    move_piece(move.from(), move.to());
+  }
   constexpr void move_piece(Square from, Square to) {
-    board.move_piece(from, to);
+    _board.move_piece(from, to);
   }
   constexpr void set_piece(Square to, Piece p = Piece::empty()) {
-    board.set_piece(to, p);
+    _board.set_piece(to, p);
   }
 };
+
+static_assert(sizeof(GameState) == 128 && alignof(GameState) == 64);
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+Allocation of the big tables of the engine (transposition table, ...)
+
+With tables of many GB every random probe is also a TLB miss, so the memory
+is requested aligned to 2 MB and marked for transparent huge pages.
+The memory is then touched for the first time by one thread per core, so that
+on NUMA machines the pages are spread on the nodes of the threads that will
+use them (Linux places a page on the node of the thread that touches it first)
+
+  | Thread | Pinned to core | Touches                |
+  | ------ | -------------- | ---------------------- |
+  | 0      | cpus()[0]      | [0, size / n)          |
+  | 1      | cpus()[1]      | [size / n, 2 size / n) |
+  | ...    | ...            | ...                    |
+
+cpus() are the CPUs in the affinity mask of the process (taskset, cpuset)
+*/
+
+class LargePage {
+public:
+  static constexpr std::size_t SIZE = 2 * 1024 * 1024; // 2 MB
+
+  // round up bytes to a multiple of the huge page size
+  static constexpr std::size_t round_up(std::size_t bytes) {
+    return (bytes + SIZE - 1) / SIZE * SIZE;
+  }
+
+  // Allocate at least 'bytes' bytes aligned to 2 MB
+  // Note: the memory is not touched, call first_touch() to fault it in
+  static inline void *alloc(std::size_t bytes) {
+    bytes = round_up(bytes);
+#if defined(__linux__)
+    // over allocate and trim to get an address aligned to the huge page
+    const std::size_t mapped = bytes + SIZE;
+    void *raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+      throw std::bad_alloc();
+
+    const auto addr = reinterpret_cast<std::uintptr_t>(raw);
+    const auto aligned = (addr + SIZE - 1) / SIZE * SIZE;
+    const std::size_t head = aligned - addr;
+    const std::size_t tail = mapped - head - bytes;
+    if (head)
+      munmap(raw, head);
+    if (tail)
+      munmap(reinterpret_cast<void *>(aligned + bytes), tail);
+
+    void *mem = reinterpret_cast<void *>(aligned);
+#if defined(MADV_HUGEPAGE)
+    madvise(mem, bytes, MADV_HUGEPAGE); // only a hint, ignore failures
+#endif
+    return mem;
+#else
+    void *mem = std::aligned_alloc(SIZE, bytes);
+    if (!mem)
+      throw std::bad_alloc();
+    return mem;
+#endif
+  }
+
+  // Free memory obtained by alloc(bytes) (bytes must be the same)
+  static inline void free(void *mem, std::size_t bytes) {
+    if (!mem)
+      return;
+#if defined(__linux__)
+    munmap(mem, round_up(bytes));
+#else
+    (void)bytes;
+    std::free(mem);
+#endif
+  }
+
+  // Zero the memory in parallel, thread i works on the i-th contiguous block
+  // and, if pin is true, runs on core i (the same core the i-th search thread
+  // should be pinned to)
+  static inline void first_touch(void *mem, std::size_t bytes,
+                                 std::size_t threads, bool pin = false) {
+    threads = std::max<std::size_t>(threads, 1);
+    // blocks are multiple of the huge page so no page is split between nodes
+    const std::size_t pages = round_up(bytes) / SIZE;
+    const std::size_t per_thread = (pages + threads - 1) / threads;
+
+    auto touch = [=](std::size_t i) {
+      if (pin)
+        pin_current_thread(i);
+      const std::size_t begin = std::min(i * per_thread * SIZE, bytes);
+      const std::size_t end = std::min((i + 1) * per_thread * SIZE, bytes);
+      if (begin < end)
+        std::memset(static_cast<char *>(mem) + begin, 0, end - begin);
+    };
+
+    if (threads == 1 && !pin) {
+      touch(0);
+      return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i)
+      workers.emplace_back(touch, i);
+    for (auto &w : workers)
+      w.join();
+  }
+
+  // Pin the calling thread to the index-th CPU the process is allowed to run
+  // on (wraps around), so it works also inside a cpuset / taskset
+  // return false if not supported or if it fails (a warning is printed once)
+  static inline bool pin_current_thread(std::size_t index) {
+#if defined(__linux__)
+    const std::vector<int> &allowed = cpus();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(allowed[index % allowed.size()], &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0)
+      return true;
+    static std::once_flag warned;
+    std::call_once(warned, [&] {
+      std::fprintf(stderr, "warning: cannot pin the threads to the CPUs\n");
+    });
+    return false;
+#else
+    (void)index;
+    return false;
+#endif
+  }
+
+#if defined(__linux__)
+  // CPUs in the affinity mask of the process (read once, from the main
+  // thread, so threads already pinned don't restrict it)
+  static inline const std::vector<int> &cpus() {
+    static const std::vector<int> allowed = [] {
+      std::vector<int> list;
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      if (sched_getaffinity(getpid(), sizeof(set), &set) == 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+          if (CPU_ISSET(cpu, &set))
+            list.push_back(cpu);
+      if (list.empty()) { // unknown mask: all the cores
+        const unsigned cores =
+            std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned cpu = 0; cpu < cores; ++cpu)
+          list.push_back(static_cast<int>(cpu));
+      }
+      return list;
+    }();
+    return allowed;
+  }
+#endif
+};
+
+// Fixed size array of T allocated on huge pages
+// T must be trivial: the entries start zeroed and are never constructed
+template <typename T> class LargeTable {
+  static_assert(std::is_trivially_copyable_v<T> &&
+                    std::is_trivially_default_constructible_v<T>,
+                "LargeTable only holds trivial types");
+
+private:
+  T *_data = nullptr;
+  std::size_t _size = 0;
+
+public:
+  constexpr LargeTable() = default;
+  inline explicit LargeTable(std::size_t size, std::size_t threads = 1,
+                             bool pin = false) {
+    resize(size, threads, pin);
+  }
+  inline ~LargeTable() { release(); }
+
+  LargeTable(const LargeTable &) = delete;
+  LargeTable &operator=(const LargeTable &) = delete;
+  inline LargeTable(LargeTable &&t) noexcept
+      : _data(std::exchange(t._data, nullptr)),
+        _size(std::exchange(t._size, 0)) {}
+  inline LargeTable &operator=(LargeTable &&t) noexcept {
+    if (this != &t) {
+      release();
+      _data = std::exchange(t._data, nullptr);
+      _size = std::exchange(t._size, 0);
+    }
+    return *this;
+  }
+
+  // Reallocate the table with size entries, all zeroed
+  inline void resize(std::size_t size, std::size_t threads = 1,
+                     bool pin = false) {
+    release();
+    if (size == 0)
+      return;
+    _data = static_cast<T *>(LargePage::alloc(size * sizeof(T)));
+    _size = size;
+    LargePage::first_touch(_data, bytes(), threads, pin);
+  }
+
+  // Zero all the entries (in parallel like the first touch)
+  inline void clear(std::size_t threads = 1, bool pin = false) {
+    LargePage::first_touch(_data, bytes(), threads, pin);
+  }
+
+  constexpr T &operator[](std::size_t i) {
+    assert(i < _size);
+    return _data[i];
+  }
+  constexpr const T &operator[](std::size_t i) const {
+    assert(i < _size);
+    return _data[i];
+  }
+
+  constexpr T *data() { return _data; }
+  constexpr const T *data() const { return _data; }
+  constexpr std::size_t size() const { return _size; }
+  constexpr std::size_t bytes() const { return _size * sizeof(T); }
+
+private:
+  inline void release() {
+    LargePage::free(_data, bytes());
+    _data = nullptr;
+    _size = 0;
+  }
+};
@@ -1,3 +1,14 @@
 #pragma once
 
+#include "attacks.hpp"
 #include "board.hpp"
+#include "datafile.hpp"
+#include "epd.hpp"
+#include "eval.hpp"
+#include "largepage.hpp"
+#include "movegen.hpp"
+#include "packed.hpp"
+#include "search.hpp"
+#include "threadpool.hpp"
+#include "tt.hpp"
+#include "zobrist.hpp"
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cli.hpp"
+#include "epd.hpp"
+#include "gamestate.hpp"
+#include "movegen.hpp"
+#include "sprt.hpp"
+#include "threadpool.hpp"
+#include "uciengine.hpp"
+#include "zobrist.hpp"
+
+/*
+Engine vs engine match with SPRT
+
+  tiresia match --engine1 CMD [--engine2 CMD] [--options1 N=V,N=V]
+                [--options2 N=V,N=V] [--openings book.epd] [--games N]
+                [--concurrency C] [--limits "nodes 10000"] [--timeout MS]
+                [--elo0 0] [--elo1 5] [--alpha 0.05] [--beta 0.05]
+
+engine2 defaults to engine1, so two option sets of the same binary can be
+compared. Every worker of the pool runs one instance of each engine and
+plays game pairs: the same opening twice with the colors swapped. After
+every pair the pentanomial results are updated and the match stops as soon
+as the SPRT accepts H0 (engine1 is not better than elo0) or H1 (engine1 is
+better than elo1), or after --games games.
+There should be an opening for every pair: with less openings they are
+played again (a warning is printed) and the pairs are not independent.
+An engine that does not answer a go within --timeout milliseconds is killed
+and the match stops.
+
+The games are followed with a GameState, every move of the engines is
+checked against MoveGen::legal_moves. A game ends when:
+  - the side to move has no legal move: checkmate or stalemate
+  - the engine to move answers an illegal move (or no move): lost
+  - threefold repetition (Zobrist keys, like datagen): draw
+  - both engines agree that a side is winning by at least adjudicate-score
+    for adjudicate-plies plies
+  - 50 moves rule or max-plies plies: draw
+*/
+
+class Match {
+public:
+  struct Options {
+    std::array<std::string, 2> engine;
+    std::array<std::string, 2> options;
+    std::string openings; // empty = standard start position
+    uint64_t games = 1000;
+    std::size_t concurrency = ThreadPool::default_threads();
+    std::string limits = "nodes 10000";
+    std::chrono::milliseconds timeout = UciEngine::DEFAULT_TIMEOUT;
+    int maxPlies = 400;
+    int adjudicateScore = 1000; // centipawns
+    int adjudicatePlies = 8;
+    Sprt sprt;
+  };
+
+  static inline Options options(const Args &args) {
+    Options opt;
+    opt.engine[0] = args.get("engine1");
+    if (opt.engine[0].empty())
+      throw std::runtime_error("match: missing --engine1");
+    opt.engine[1] = args.get("engine2", opt.engine[0]);
+    opt.options[0] = args.get("options1");
+    opt.options[1] = args.get("options2");
+    opt.openings = args.get("openings");
+    opt.games = args.get_int("games", opt.games);
+    opt.concurrency = args.get_int("concurrency", opt.concurrency);
+    opt.limits = args.get("limits", opt.limits);
+    opt.timeout = std::chrono::milliseconds(
+        args.get_int("timeout", opt.timeout.count()));
+    opt.maxPlies = args.get_int("max-plies", opt.maxPlies);
+    opt.adjudicateScore =
+        args.get_int("adjudicate-score", opt.adjudicateScore);
+    opt.adjudicatePlies =
+        args.get_int("adjudicate-plies", opt.adjudicatePlies);
+    opt.sprt = Sprt(std::stod(args.get("elo0", "0")),
+                    std::stod(args.get("elo1", "5")),
+                    std::stod(args.get("alpha", "0.05")),
+                    std::stod(args.get("beta", "0.05")));
+    return opt;
+  }
+
+  static inline int run(const Args &args) {
+    Match match(options(args));
+    const Sprt::Result result = match.run();
+    std::fprintf(stderr, "match: %s\n",
+                 result == Sprt::H1   ? "H1 accepted (engine1 is better)"
+                 : result == Sprt::H0 ? "H0 accepted (engine1 is not better)"
+                                      : "no SPRT result");
+    return 0;
+  }
+
+  inline explicit Match(const Options &opt) : opt(opt) {
+    if (!opt.openings.empty()) {
+      std::ifstream in(opt.openings);
+      if (!in)
+        throw std::runtime_error("match: cannot open " + opt.openings);
+      for (std::string line; std::getline(in, line);)
+        if (Epd::is_record(line))
+          openings.push_back(Epd(line).fen());
+    }
+    if (openings.empty())
+      openings.push_back(
+          "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    if (openings.size() < opt.games / 2)
+      std::fprintf(stderr,
+                   "match: warning: %zu openings for %llu pairs, the "
+                   "openings are repeated\n",
+                   openings.size(),
+                   static_cast<unsigned long long>(opt.games / 2));
+  }
+
+  inline Sprt::Result run() {
+    std::atomic<uint64_t> next = 0;
+    {
+      ThreadPool pool(opt.concurrency);
+      for (std::size_t i = 0; i < pool.size(); ++i)
+        pool.submit([&](std::size_t) {
+          try {
+            std::array<UciEngine, 2> engines{
+                UciEngine(opt.engine[0], opt.timeout),
+                UciEngine(opt.engine[1], opt.timeout)};
+            for (int e = 0; e < 2; ++e)
+              if (!opt.options[e].empty())
+                engines[e].set_options(opt.options[e]);
+
+            uint64_t pair;
+            while (!stop && (pair = next++) < opt.games / 2) {
+              const std::string &fen = openings[pair % openings.size()];
+              // score of engine1 in the 2 games
+              const double score =
+                  play(engines, fen, 0) + (1.0 - play(engines, fen, 1));
+              add(score);
+            }
+          } catch (const std::exception &e) {
+            std::fprintf(stderr, "match: %s\n", e.what());
+            stop = true;
+          }
+        });
+    }
+    std::lock_guard lock(mutex);
+    return opt.sprt.test(penta);
+  }
+
+  // Pentanomial results of engine1
+  inline Sprt::Pentanomial results() {
+    std::lock_guard lock(mutex);
+    return penta;
+  }
+
+private:
+  const Options opt;
+  std::vector<std::string> openings; // FEN
+  std::mutex mutex;
+  Sprt::Pentanomial penta{};
+  std::atomic<bool> stop = false;
+
+  // Play a game, return the score of the engine with white
+  inline double play(std::array<UciEngine, 2> &engines,
+                     const std::string &fen, int white) {
+    GameState gs(fen);
+    std::string moves;
+    std::vector<uint64_t> keys; // keys of the game
+    for (auto &e : engines)
+      e.new_game();
+
+    int winning = 0; // consecutive plies with the same winning side (+ white)
+    for (int ply = 0; ply < opt.maxPlies; ++ply) {
+      const bool whiteToMove = gs.turn() == Piece::Color::WHITE;
+
+      // the positions since the last capture or pawn move can repeat
+      keys.push_back(Zobrist::hash(gs));
+      const std::size_t reversible =
+          std::min<std::size_t>(keys.size(), gs.halfMoveClock() + 1);
+      if (std::count(keys.end() - reversible, keys.end(), keys.back()) >= 3)
+        return 0.5; // threefold repetition
+
+      const MoveList legal = MoveGen::legal_moves(gs);
+      if (legal.empty()) // checkmate or stalemate
+        return gs.in_check() ? (whiteToMove ? 0.0 : 1.0) : 0.5;
+
+      const int e = whiteToMove ? white : 1 - white;
+      const std::string position =
+          "position fen " + fen + (moves.empty() ? "" : " moves" + moves);
+      const UciEngine::GoResult r = engines[e].go(position, opt.limits);
+
+      const std::optional<Move> move = find(gs, legal, r.bestMove);
+      if (!move) {
+        std::fprintf(stderr, "match: engine%d: illegal move %s after %s\n",
+                     e + 1, r.bestMove.c_str(), position.c_str());
+        return whiteToMove ? 0.0 : 1.0;
+      }
+
+      // score adjudication (the score is from the side to move)
+      int score = r.mate ? (*r.mate > 0 ? 100000 : -100000) : r.cp.value_or(0);
+      if (!whiteToMove)
+        score = -score;
+      if (score >= opt.adjudicateScore)
+        winning = winning > 0 ? winning + 1 : 1;
+      else if (score <= -opt.adjudicateScore)
+        winning = winning < 0 ? winning - 1 : -1;
+      else
+        winning = 0;
+      if (winning >= opt.adjudicatePlies)
+        return 1.0;
+      if (-winning >= opt.adjudicatePlies)
+        return 0.0;
+
+      gs.make_move(*move);
+      moves += ' ' + r.bestMove;
+      if (gs.halfMoveClock() >= 100)
+        return 0.5;
+    }
+    return 0.5;
+  }
+
+  // The move in the legal moves of gs, nothing if it is not one of them
+  // (or not a move at all, like (none) or 0000)
+  static inline std::optional<Move> find(const GameState &gs,
+                                         const MoveList &legal,
+                                         const std::string &uci) {
+    try {
+      const Move m = gs.move_from_uci(uci);
+      for (int i = 0; i < legal.size(); ++i)
+        if (legal[i] == m)
+          return m;
+    } catch (const std::exception &) {
+    }
+    return std::nullopt;
+  }
+
+  // Add the score of a pair (0, 0.5, ..., 2) and check the SPRT
+  inline void add(double score) {
+    std::lock_guard lock(mutex);
+    ++penta[static_cast<int>(score * 2 + 0.5)];
+
+    const auto [elo, error] = Sprt::elo_error(penta);
+    std::fprintf(stderr,
+                 "match: games %llu [%llu %llu %llu %llu %llu] elo %.1f +- "
+                 "%.1f LLR %.2f (%.2f, %.2f)\n",
+                 static_cast<unsigned long long>(2 * Sprt::pairs(penta)),
+                 static_cast<unsigned long long>(penta[0]),
+                 static_cast<unsigned long long>(penta[1]),
+                 static_cast<unsigned long long>(penta[2]),
+                 static_cast<unsigned long long>(penta[3]),
+                 static_cast<unsigned long long>(penta[4]), elo, error,
+                 opt.sprt.llr(penta), opt.sprt.lower(), opt.sprt.upper());
+    if (opt.sprt.test(penta) != Sprt::CONTINUE)
+      stop = true;
+  }
+};
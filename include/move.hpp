@@ -120,6 +120,18 @@ public:
     set_type(type);
   }
 
+  // The 16 bits of the move, to store it in the tables (see from_raw)
+  constexpr uint16_t raw() const { return data; }
+  static constexpr Move from_raw(uint16_t raw) {
+    Move m(Square::from(Square::A1), Square::from(Square::A1));
+    m.data = raw;
+    return m;
+  }
+
+  constexpr bool operator==(const Move &move) const {
+    return data == move.data;
+  }
+
   constexpr bool operator==(const Type type) const {
     return this->type() == type;
   }
@@ -140,6 +152,26 @@ public:
     return static_cast<Move::Type>((data & TYPE_MASK) >> TYPE_SHIFT);
   }
 
+  // to_string in UCI notation (e2e4, e7e8q, ...)
+  // Castling is the king moving on its own rook (Chess960 notation, e1h1),
+  // with chess960 = false it is the king moving to the g/c file (e1g1)
+  inline std::string to_string(bool chess960 = true) const {
+    if (type() == Type::CASTLING && !chess960) {
+      const uint8_t rank = from() / 8 * 8;
+      const Square king = static_cast<uint8_t>(rank + (to() > from() ? 6 : 2));
+      return from().to_string() + king.to_string();
+    }
+    std::string str = from().to_string() + to().to_string();
+    switch (type()) { // clang-format off
+    case Type::PROMOTION_KNIGHT: str += 'n'; break;
+    case Type::PROMOTION_BISHOP: str += 'b'; break;
+    case Type::PROMOTION_ROOK:   str += 'r'; break;
+    case Type::PROMOTION_QUEEN:  str += 'q'; break;
+    default: break;
+    } // clang-format on
+    return str;
+  }
+
 private:
   constexpr void set_from(Square from) {
     data &= ~FROM_MASK;
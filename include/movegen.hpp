@@ -0,0 +1,232 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+#include "attacks.hpp"
+#include "gamestate.hpp"
+#include "move.hpp"
+#include "piece.hpp"
+
+// Fixed capacity list of moves (no legal position has more than 218), the
+// moves are stored as raw 16 bits since Move has no default constructor
+class MoveList {
+public:
+  static constexpr int CAPACITY = 256;
+
+  constexpr void push(Move m) { moves[count++] = m.raw(); }
+  constexpr int size() const { return count; }
+  constexpr bool empty() const { return count == 0; }
+  constexpr Move operator[](int i) const { return Move::from_raw(moves[i]); }
+  constexpr void swap(int i, int j) { std::swap(moves[i], moves[j]); }
+
+private:
+  std::array<uint16_t, CAPACITY> moves;
+  int count = 0;
+};
+
+/*
+Pseudo-legal move generation, the moves that leave the own king in check are
+filtered by legal() (the move is played on a copy of the position)
+
+  | Kind     | Moves                                               |
+  | -------- | --------------------------------------------------- |
+  | ALL      | every move                                          |
+  | CAPTURES | captures, en passant and promotions to queen        |
+
+Castling is the king moving on its own rook (see GameState::make_move), it
+is generated only if the squares between the king and the rook and their
+destinations are empty and the king is not in check and does not pass
+through an attacked square (works for Chess960)
+*/
+
+class MoveGen {
+public:
+  enum Kind { ALL, CAPTURES };
+
+  static inline MoveList generate(const GameState &gs, Kind kind = ALL) {
+    MoveList list;
+    const Board &b = gs.board();
+    const Piece::Color us = gs.turn(), them = gs.opponent();
+    const uint64_t own = b.occupancy(us), enemy = b.occupancy(them);
+    const uint64_t all = b.occupancy();
+    const uint64_t targets = kind == CAPTURES ? enemy : ~own;
+
+    pawns(gs, kind, list);
+
+    for (int t = Piece::Type::KNIGHT; t <= Piece::Type::KING; ++t) {
+      const auto type = static_cast<Piece::Type>(t);
+      for (uint64_t bb = b.bitboard(us, type); bb; bb &= bb - 1) {
+        const int from = std::countr_zero(bb);
+        add(list, from, Attacks::of(type, us, from, all) & targets);
+      }
+    }
+
+    if (kind == ALL)
+      castling(gs, list);
+    return list;
+  }
+
+  // The move does not leave the own king in check (a position without king
+  // has no check)
+  static inline bool legal(const GameState &gs, const Move &m) {
+    GameState next = gs;
+    next.make_move(m);
+    return !exposed(next);
+  }
+
+  // The king of the side that just moved is attacked (next is the position
+  // after the move)
+  static inline bool exposed(const GameState &next) {
+    const uint64_t king =
+        next.board().bitboard(next.opponent(), Piece::Type::KING);
+    return king && next.board().is_attacked(sq(std::countr_zero(king)),
+                                            next.turn());
+  }
+
+  // Only the legal moves
+  static inline MoveList legal_moves(const GameState &gs) {
+    const MoveList pseudo = generate(gs);
+    MoveList list;
+    for (int i = 0; i < pseudo.size(); ++i)
+      if (legal(gs, pseudo[i]))
+        list.push(pseudo[i]);
+    return list;
+  }
+
+  // Number of leaf nodes at depth (ref:
+  // https://www.chessprogramming.org/Perft_Results)
+  static inline uint64_t perft(const GameState &gs, int depth) {
+    if (depth <= 0)
+      return 1;
+    const MoveList moves = generate(gs);
+    uint64_t nodes = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+      GameState next = gs;
+      next.make_move(moves[i]);
+      if (exposed(next))
+        continue;
+      nodes += depth == 1 ? 1 : perft(next, depth - 1);
+    }
+    return nodes;
+  }
+
+private:
+  static constexpr uint64_t RANK_1 = 0xFFULL;
+  static constexpr uint64_t RANK_3 = RANK_1 << 16;
+  static constexpr uint64_t RANK_6 = RANK_1 << 40;
+  static constexpr uint64_t RANK_8 = RANK_1 << 56;
+
+  static constexpr Square sq(int i) { return static_cast<uint8_t>(i); }
+
+  static constexpr void add(MoveList &list, int from, uint64_t targets) {
+    for (; targets; targets &= targets - 1)
+      list.push(Move(sq(from), sq(std::countr_zero(targets))));
+  }
+
+  static constexpr void promotions(MoveList &list, int from, int to,
+                                   Kind kind) {
+    list.push(Move(sq(from), sq(to), Move::Type::PROMOTION_QUEEN));
+    if (kind == CAPTURES)
+      return;
+    list.push(Move(sq(from), sq(to), Move::Type::PROMOTION_KNIGHT));
+    list.push(Move(sq(from), sq(to), Move::Type::PROMOTION_ROOK));
+    list.push(Move(sq(from), sq(to), Move::Type::PROMOTION_BISHOP));
+  }
+
+  static inline void pawns(const GameState &gs, Kind kind, MoveList &list) {
+    const Board &b = gs.board();
+    const Piece::Color us = gs.turn();
+    const bool white = us == Piece::Color::WHITE;
+    const uint64_t pawns = b.bitboard(us, Piece::Type::PAWN);
+    const uint64_t empty = ~b.occupancy();
+    const uint64_t enemy = b.occupancy(gs.opponent());
+    const uint64_t last = white ? RANK_8 : RANK_1;
+    const int up = white ? 8 : -8;
+
+    // pushes, all at once
+    const uint64_t single = (white ? pawns << 8 : pawns >> 8) & empty;
+    for (uint64_t bb = single & last; bb; bb &= bb - 1) {
+      const int to = std::countr_zero(bb);
+      promotions(list, to - up, to, kind);
+    }
+    if (kind == ALL) {
+      for (uint64_t bb = single & ~last; bb; bb &= bb - 1) {
+        const int to = std::countr_zero(bb);
+        list.push(Move(sq(to - up), sq(to)));
+      }
+      const uint64_t twice =
+          (white ? (single & RANK_3) << 8 : (single & RANK_6) >> 8) & empty;
+      for (uint64_t bb = twice; bb; bb &= bb - 1) {
+        const int to = std::countr_zero(bb);
+        list.push(
+            Move(sq(to - 2 * up), sq(to), Move::Type::DOUBLE_PAWN_PUSH));
+      }
+    }
+
+    // captures
+    const Square ep = gs.enPassantSquare();
+    for (uint64_t bb = pawns; bb; bb &= bb - 1) {
+      const int from = std::countr_zero(bb);
+      const uint64_t attacks = Attacks::pawn(us, from);
+      for (uint64_t t = attacks & enemy; t; t &= t - 1) {
+        const int to = std::countr_zero(t);
+        if ((1ULL << to) & last)
+          promotions(list, from, to, kind);
+        else
+          list.push(Move(sq(from), sq(to)));
+      }
+      if (ep != Square::NONE && (attacks & Square::to_uint64(ep)))
+        list.push(Move(sq(from), ep, Move::Type::EN_PASSANT));
+    }
+  }
+
+  static inline void castling(const GameState &gs, MoveList &list) {
+    const CastleRights rights = gs.castleRights();
+    const Piece::Color us = gs.turn();
+    const bool white = us == Piece::Color::WHITE;
+    if (!(rights & (white ? CastleRights::WHITE_CASTLING
+                          : CastleRights::BLACK_CASTLING)))
+      return;
+
+    const Board &b = gs.board();
+    const int rank = white ? 0 : 56;
+    const uint64_t kingBB = b.bitboard(us, Piece::Type::KING) &
+                            (white ? RANK_1 : RANK_8);
+    if (!kingBB || gs.in_check())
+      return;
+    const int king = std::countr_zero(kingBB);
+
+    for (const bool kingside : {true, false}) {
+      const auto right = white ? (kingside ? CastleRights::WHITE_KINGSIDE
+                                           : CastleRights::WHITE_QUEENSIDE)
+                               : (kingside ? CastleRights::BLACK_KINGSIDE
+                                           : CastleRights::BLACK_QUEENSIDE);
+      if (!rights.has(right))
+        continue;
+      const int rook = rank + rights.rook_file(right);
+      const int kingTo = rank + (kingside ? 6 : 2); // g or c file
+      const int rookTo = rank + (kingside ? 5 : 3); // f or d file
+
+      // the king and the rook can jump each other
+      const uint64_t others =
+          b.occupancy() & ~Square::to_uint64(sq(king), sq(rook));
+      const uint64_t path = Attacks::between(king, kingTo) |
+                            Attacks::between(rook, rookTo) |
+                            Square::to_uint64(sq(kingTo), sq(rookTo));
+      if (others & path)
+        continue;
+
+      // the squares crossed by the king (the destination is checked by
+      // legal() like for any other move)
+      bool attacked = false;
+      for (uint64_t bb = Attacks::between(king, kingTo); bb && !attacked;
+           bb &= bb - 1)
+        attacked = b.is_attacked(sq(std::countr_zero(bb)), gs.opponent());
+      if (!attacked)
+        list.push(Move(sq(king), sq(rook), Move::Type::CASTLING));
+    }
+  }
+};
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "board.hpp"
+#include "castle.hpp"
+#include "gamestate.hpp"
+#include "move.hpp"
+#include "piece.hpp"
+
+/*
+Compact encoding of a GameState in 32 bytes (GameState is 128 bytes)
+
+  | Bytes  | Field                                                  |
+  | ------ | ------------------------------------------------------ |
+  | 0-7    | occupancy bitboard                                     |
+  | 8-23   | 4 bit piece code of every occupied square (max 32),    |
+  |        | in order of square (a1 first), low nibble first        |
+  | 24     | bit 0 = turn                                           |
+  | 25     | en passant square (64 = none)                          |
+  | 26     | half move clock (saturated at 255)                     |
+  | 27     | result of the game (training data, 0 otherwise)        |
+  | 28-29  | full move number                                       |
+  | 30-31  | score (training data, 0 otherwise)                     |
+
+  Piece code = 0bCTTT (C = color, TTT = type, 0 = empty)
+             = 0bC111 for a rook with a castle right (works for Chess960)
+
+Score and result are from the point of view of the side to move, they are not
+part of the GameState and are ignored by unpack() and operator==.
+
+Pack and unpack go through 4 planes, plane k = the squares whose piece code
+has bit k set, computed with a few bitboard operations (the type bits of the
+codes are chosen so that every plane is a union of piece bitboards). The
+nibbles are the planes compressed to the occupied squares and interleaved:
+with BMI2 a pext/pdep per plane, without it a single pass over the occupied
+squares.
+The layout is the in-memory layout on a little endian machine, so the packed
+positions can be written to and read from a file as they are (see
+datafile.hpp)
+*/
+
+class PackedPosition {
+private:
+  uint64_t _occupancy;
+  std::array<uint8_t, 16> _pieces;
+  uint8_t _flags;
+  uint8_t _enPassantSquare;
+  uint8_t _halfMoveClock;
+  int8_t _result;
+  uint16_t _fullMoveNumber;
+  int16_t _score;
+
+public:
+  enum Result : int8_t { LOSS = -1, DRAW = 0, WIN = 1 };
+
+  static constexpr int MAX_PIECES = 32;
+
+  constexpr PackedPosition()
+      : _occupancy(0), _pieces{}, _flags(0),
+        _enPassantSquare(Square::NONE), _halfMoveClock(0), _result(DRAW),
+        _fullMoveNumber(1), _score(0) {}
+
+  // Encode a GameState (throws if the board has more than 32 pieces)
+  inline explicit PackedPosition(const GameState &gs) : PackedPosition() {
+    const Board &b = gs.board();
+    _occupancy = b.occupancy();
+    if (std::popcount(_occupancy) > MAX_PIECES)
+      throw std::runtime_error("PackedPosition: too many pieces");
+
+    // castling rooks
+    uint64_t castling = 0;
+    const CastleRights rights = gs.castleRights();
+    for (int r = 0; r < 4; ++r) {
+      const auto right = static_cast<CastleRights::Value>(1 << r);
+      if (rights.has(right))
+        castling |= 1ULL << ((r < 2 ? 0 : 56) + rights.rook_file(right));
+    }
+
+    const auto both = [&](Piece::Type t) {
+      return b.bitboard(Piece::Color::WHITE, t) |
+             b.bitboard(Piece::Color::BLACK, t);
+    };
+    const uint64_t bishops = both(Piece::Type::BISHOP);
+    const uint64_t queens = both(Piece::Type::QUEEN);
+    const uint64_t kings = both(Piece::Type::KING);
+    const Planes planes{
+        both(Piece::Type::PAWN) | bishops | queens | castling,
+        both(Piece::Type::KNIGHT) | bishops | kings | castling,
+        both(Piece::Type::ROOK) | queens | kings,
+        b.occupancy(Piece::Color::BLACK)};
+    _pieces = std::bit_cast<std::array<uint8_t, 16>>(
+        little_endian(encode(_occupancy, planes)));
+
+    _flags = static_cast<uint8_t>(gs.turn());
+    _enPassantSquare = gs.enPassantSquare();
+    _halfMoveClock =
+        gs.halfMoveClock() > 255 ? 255 : uint8_t(gs.halfMoveClock());
+    _fullMoveNumber = gs.fullMoveNumber();
+  }
+
+  static inline PackedPosition pack(const GameState &gs) {
+    return PackedPosition(gs);
+  }
+
+  // Decode to a GameState (throws if the encoding is not valid)
+  // The bitboards are the planes combined, there is no work per piece
+  // outside of decode() (see bench/bench_packed.cpp)
+  inline GameState unpack() const {
+    if (std::popcount(_occupancy) > MAX_PIECES)
+      throw std::runtime_error("PackedPosition: too many pieces");
+    if (_enPassantSquare > Square::NONE)
+      throw std::runtime_error("PackedPosition: invalid en passant square");
+
+    const auto [p0, p1, p2, black] = decode(
+        _occupancy,
+        little_endian(std::bit_cast<std::array<uint64_t, 2>>(_pieces)));
+    if (_occupancy & ~(p0 | p1 | p2)) [[unlikely]]
+      throw std::runtime_error("PackedPosition: invalid piece code");
+    const uint64_t castling = p0 & p1 & p2;
+
+    // by type, for both colors
+    const std::array<uint64_t, Piece::Type::PIECE_NB> types{
+        0,
+        p0 & ~p1 & ~p2,  // 001 pawn
+        ~p0 & p1 & ~p2,  // 010 knight
+        p0 & p1 & ~p2,   // 011 bishop
+        p2 & ~(p0 ^ p1), // 100 rook, 111 castling rook
+        p0 & ~p1 & p2,   // 101 queen
+        ~p0 & p1 & p2,   // 110 king
+    };
+    Board::Bitboards bitboards;
+    for (int t = 0; t < Piece::Type::PIECE_NB; ++t) {
+      bitboards[Piece::Color::WHITE][t] = types[t] & ~black;
+      bitboards[Piece::Color::BLACK][t] = types[t] & black;
+    }
+    const Board b = Board::from_bitboards(bitboards);
+
+    // a castling rook is on the first rank of its color, with its king (like
+    // GameState::castle_rights, the side is where the rook is from the king)
+    CastleRights rights = CastleRights::none();
+    for (uint64_t bb = castling; bb; bb &= bb - 1) {
+      const int sq = std::countr_zero(bb);
+      const int color = black >> sq & 1;
+      const uint64_t rank = color ? 0xFFULL << 56 : 0xFFULL;
+      const uint64_t king = bitboards[color][Piece::Type::KING] & rank;
+      if (!king || !(rank >> sq & 1))
+        continue;
+      const bool kingside = sq % 8 > std::countr_zero(king) % 8;
+      rights.add(static_cast<CastleRights::Value>(
+                     (kingside ? CastleRights::WHITE_KINGSIDE
+                               : CastleRights::WHITE_QUEENSIDE)
+                     << (2 * color)),
+                 sq % 8);
+    }
+
+    return GameState(b, static_cast<Piece::Color>(_flags & 1), rights,
+                     Square(_enPassantSquare), _halfMoveClock,
+                     _fullMoveNumber);
+  }
+
+  // Call f(square, piece) for every piece, in order of square, without
+  // building the Board (for who only needs the pieces, like the evaluation)
+  template <typename F> inline void for_each_piece(F f) const {
+    int i = 0;
+    for (uint64_t bb = _occupancy; bb && i < MAX_PIECES; bb &= bb - 1, ++i)
+      f(Square(static_cast<uint8_t>(std::countr_zero(bb))),
+        piece((_pieces[i >> 1] >> ((i & 1) * 4)) & 0xF));
+  }
+
+  // Same position (score and result are not compared)
+  constexpr bool operator==(const PackedPosition &p) const {
+    return _occupancy == p._occupancy && _pieces == p._pieces &&
+           _flags == p._flags && _enPassantSquare == p._enPassantSquare &&
+           _halfMoveClock == p._halfMoveClock &&
+           _fullMoveNumber == p._fullMoveNumber;
+  }
+
+  // Getters (no need to unpack)
+  constexpr uint64_t occupancy() const { return _occupancy; }
+  constexpr Piece::Color turn() const {
+    return static_cast<Piece::Color>(_flags & 1);
+  }
+  constexpr int16_t score() const { return _score; }
+  constexpr Result result() const { return static_cast<Result>(_result); }
+
+  // Setters
+  constexpr void set_score(int16_t score) { _score = score; }
+  constexpr void set_result(Result result) { _result = result; }
+
+private:
+  static constexpr uint8_t CASTLING_ROOK = 0b111;
+
+  // Bit k of the piece codes, by square
+  using Planes = std::array<uint64_t, 4>;
+  using Nibbles = std::array<uint64_t, 2>; // nibble i = bits 4i..4i+3
+
+  // The nibbles as stored, the first one in the low bits of the first byte
+  static constexpr Nibbles little_endian(Nibbles n) {
+    if constexpr (std::endian::native == std::endian::big)
+      return {std::byteswap(n[0]), std::byteswap(n[1])};
+    return n;
+  }
+
+#if defined(__BMI2__)
+  // 16 bits to bit 0 of 16 nibbles and back
+  static constexpr uint64_t NIBBLE_BIT0 = 0x1111111111111111ULL;
+
+  static inline Nibbles encode(uint64_t occupancy, const Planes &planes) {
+    Nibbles n{};
+    for (int k = 0; k < 4; ++k) {
+      const uint64_t bits = _pext_u64(planes[k], occupancy);
+      n[0] |= _pdep_u64(bits, NIBBLE_BIT0 << k);
+      n[1] |= _pdep_u64(bits >> 16, NIBBLE_BIT0 << k);
+    }
+    return n;
+  }
+
+  static inline Planes decode(uint64_t occupancy, const Nibbles &n) {
+    Planes planes;
+    for (int k = 0; k < 4; ++k) {
+      const uint64_t bits = _pext_u64(n[0], NIBBLE_BIT0 << k) |
+                            _pext_u64(n[1], NIBBLE_BIT0 << k) << 16;
+      planes[k] = _pdep_u64(bits, occupancy);
+    }
+    return planes;
+  }
+#else
+  // One pass over the occupied squares, in order
+  static constexpr Nibbles encode(uint64_t occupancy, const Planes &planes) {
+    Nibbles n{};
+    int i = 0;
+    for (uint64_t bb = occupancy; bb; bb &= bb - 1, ++i) {
+      const int sq = std::countr_zero(bb);
+      const uint64_t code = (planes[0] >> sq & 1) | (planes[1] >> sq & 1) << 1 |
+                            (planes[2] >> sq & 1) << 2 |
+                            (planes[3] >> sq & 1) << 3;
+      n[i >> 4] |= code << 4 * (i & 15);
+    }
+    return n;
+  }
+
+  // One bitboard per piece code, then the planes are unions of them
+  static constexpr Planes decode(uint64_t occupancy, const Nibbles &n) {
+    std::array<uint64_t, 16> byCode{};
+    uint64_t nibbles = n[0];
+    int i = 0;
+    for (uint64_t bb = occupancy; bb; bb &= bb - 1, ++i, nibbles >>= 4) {
+      if (i == 16)
+        nibbles = n[1];
+      byCode[nibbles & 0xF] |= bb & -bb;
+    }
+    std::array<uint64_t, 8> byType{}; // both colors
+    uint64_t black = 0;
+    for (int c = 0; c < 8; ++c) {
+      byType[c] = byCode[c] | byCode[c | 8];
+      black |= byCode[c | 8];
+    }
+    return {byType[1] | byType[3] | byType[5] | byType[7],
+            byType[2] | byType[3] | byType[6] | byType[7],
+            byType[4] | byType[5] | byType[6] | byType[7], black};
+  }
+#endif
+
+  static inline Piece piece(uint8_t code) {
+    // code -> piece, empty for the invalid codes
+    static constexpr std::array<Piece, 16> pieces = [] {
+      std::array<Piece, 16> p{};
+      for (uint8_t c = 0; c < 2; ++c)
+        for (uint8_t t = Piece::Type::PAWN; t < Piece::Type::PIECE_NB; ++t)
+          p[(c << 3) | t] = Piece(static_cast<Piece::Color>(c),
+                                  static_cast<Piece::Type>(t));
+      for (uint8_t c = 0; c < 2; ++c)
+        p[(c << 3) | CASTLING_ROOK] =
+            Piece(static_cast<Piece::Color>(c), Piece::Type::ROOK);
+      return p;
+    }();
+    const Piece p = pieces[code];
+    if (!p) [[unlikely]]
+      throw std::runtime_error("PackedPosition: invalid piece code");
+    return p;
+  }
+};
+
+static_assert(sizeof(PackedPosition) == 32);
@@ -40,18 +40,18 @@ public:
   constexpr explicit Piece(Type t, Color c) : Piece(c, t) {}
   constexpr explicit Piece(const char c) {
     switch (c) { // clang-format off
-    case 'p': data = PAWN   | WHITE; break;
-    case 'P': data = PAWN   | BLACK; break;
-    case 'n': data = KNIGHT | WHITE; break;
-    case 'N': data = KNIGHT | BLACK; break;
-    case 'b': data = BISHOP | WHITE; break;
-    case 'B': data = BISHOP | BLACK; break;
-    case 'r': data = ROOK   | WHITE; break;
-    case 'R': data = ROOK   | BLACK; break;
-    case 'q': data = QUEEN  | WHITE; break;
-    case 'Q': data = QUEEN  | BLACK; break;
-    case 'k': data = KING   | WHITE; break;
-    case 'K': data = KING   | BLACK; break;
+    case 'p': data = PAWN   | BLACK; break;
+    case 'P': data = PAWN   | WHITE; break;
+    case 'n': data = KNIGHT | BLACK; break;
+    case 'N': data = KNIGHT | WHITE; break;
+    case 'b': data = BISHOP | BLACK; break;
+    case 'B': data = BISHOP | WHITE; break;
+    case 'r': data = ROOK   | BLACK; break;
+    case 'R': data = ROOK   | WHITE; break;
+    case 'q': data = QUEEN  | BLACK; break;
+    case 'Q': data = QUEEN  | WHITE; break;
+    case 'k': data = KING   | BLACK; break;
+    case 'K': data = KING   | WHITE; break;
     default:  data = NO_PIECE | NO_COLOR; break;
     } // clang-format on
   }
@@ -0,0 +1,509 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "eval.hpp"
+#include "gamestate.hpp"
+#include "move.hpp"
+#include "movegen.hpp"
+#include "tt.hpp"
+#include "zobrist.hpp"
+
+// Limits and settings of a single search (0 = no limit)
+struct SearchLimits {
+  int depth = 0;
+  uint64_t nodes = 0;
+  // the search returns as soon as *stop is true (it can be set by another
+  // thread), nullptr = never stopped
+  const std::atomic<bool> *stop = nullptr;
+  // number of best lines searched by search_multipv
+  int multiPV = 1;
+  // root moves not searched
+  std::vector<Move> excluded{};
+  // parameters of the evaluation, nullptr = Eval::DEFAULT_PARAMS
+  std::shared_ptr<const EvalParams> params{};
+
+  inline bool stopped() const {
+    return stop && stop->load(std::memory_order_relaxed);
+  }
+};
+
+struct SearchResult {
+  std::optional<Move> bestMove; // nullopt if there is no legal move
+  int score = 0;                // centipawns, side to move point of view
+  std::vector<Move> pv;         // principal variation (starts with bestMove)
+  uint64_t nodes = 0;
+  int depth = 0; // depth actually completed
+};
+
+/*
+A single searcher, it owns all the state of its search (transposition table,
+history, killers) so many searchers can run at the same time on different
+threads without sharing anything
+
+Iterative deepening of a principal variation search (negamax alpha-beta)
+with aspiration windows, a quiescence search of the captures at the leaves
+and the usual pruning:
+
+  | Technique           | Where                                          |
+  | ------------------- | ---------------------------------------------- |
+  | transposition table | cutoffs at non PV nodes, first move everywhere |
+  | move ordering       | TT move, MVV-LVA captures, killers, history    |
+  | check extension     | the side to move is in check                   |
+  | null move pruning   | non PV nodes, not in check, with pieces        |
+  | late move reduction | late quiet moves that don't give check         |
+
+The node limit and the stop flag are checked during the search, the
+iteration that is interrupted is thrown away. The node limit is ignored until
+the first iteration is completed, so there is always a best move.
+*/
+
+class Searcher {
+public:
+  static constexpr int MAX_PLY = 128;
+  static constexpr int MAX_DEPTH = 100;
+  static constexpr int MATE = 32000; // mate in ply = MATE - ply
+  static constexpr int INF = MATE + 1;
+
+  // The transposition table is zeroed by threads threads (see
+  // TranspositionTable), build the Searcher on the thread that uses it
+  inline explicit Searcher(
+      std::size_t ttEntries = TranspositionTable::DEFAULT_ENTRIES,
+      std::size_t threads = 1, bool pin = false)
+      : tt(ttEntries, threads, pin) {}
+
+  // New size of the transposition table (forgets the previous searches)
+  inline void resize(std::size_t ttEntries, std::size_t threads = 1,
+                     bool pin = false) {
+    tt.resize(ttEntries, threads, pin);
+    history = {};
+    killers = {};
+  }
+
+  // Forget the previous searches (new game)
+  inline void clear() {
+    tt.clear();
+    history = {};
+    killers = {};
+  }
+
+  // Search the best line of the position (the root moves in limits.excluded
+  // are skipped)
+  inline SearchResult search(const GameState &gs, const SearchLimits &limits) {
+    return iterate(gs, limits, 1).front();
+  }
+
+  // Search the limits.multiPV best lines, best first, in a single iterative
+  // deepening: at every depth the root is searched once per line, line k
+  // without the best moves of the lines before it, and all the passes share
+  // the tables, the history and the aspiration window of their line. There
+  // are less lines if there are less root moves (a single line without move
+  // if there is none).
+  inline std::vector<SearchResult> search_multipv(const GameState &gs,
+                                                  const SearchLimits &limits) {
+    return iterate(gs, limits, std::max(limits.multiPV, 1));
+  }
+
+  // nodes searched by this searcher since its creation
+  constexpr uint64_t nodes() const { return _nodes; }
+
+private:
+  TranspositionTable tt;
+  // history[color][from][to] of the quiet moves that caused a cutoff
+  std::array<std::array<std::array<int, 64>, 64>, Piece::Color::COLOR_NB>
+      history{};
+  std::array<std::array<uint16_t, 2>, MAX_PLY + 1> killers{}; // by ply
+  // triangular table of the principal variation, row ply starts at ply
+  std::array<std::array<uint16_t, MAX_PLY + 1>, MAX_PLY + 1> pvTable;
+  std::array<int, MAX_PLY + 1> pvLength;
+  std::array<uint64_t, MAX_PLY + 1> keys; // key of the position at ply
+
+  const SearchLimits *limits = nullptr;
+  const EvalParams *params = &Eval::DEFAULT_PARAMS;
+  bool stopped = false;
+  int completed = 0; // last completed iteration
+  uint64_t searchNodes = 0;
+  uint64_t _nodes = 0;
+
+  static constexpr Move NULL_MOVE{Square(Square::A1), Square(Square::A1),
+                                  Move::Type::BULL_MOVE};
+
+  // root moves skipped by the current pass: limits.excluded and the best
+  // moves of the lines already searched at this depth
+  std::vector<uint16_t> rootExcluded;
+
+  inline std::vector<SearchResult> iterate(const GameState &gs,
+                                           const SearchLimits &limits,
+                                           int multiPV) {
+    this->limits = &limits;
+    params = limits.params ? limits.params.get() : &Eval::DEFAULT_PARAMS;
+    stopped = false;
+    searchNodes = 0;
+    completed = 0;
+    rootExcluded.clear();
+    for (const Move &m : limits.excluded)
+      rootExcluded.push_back(m.raw());
+
+    const MoveList legal = MoveGen::legal_moves(gs);
+    MoveList root;
+    for (int i = 0; i < legal.size(); ++i)
+      if (!is_excluded(legal[i]))
+        root.push(legal[i]);
+    if (root.empty()) { // checkmate, stalemate or all moves excluded
+      SearchResult none;
+      none.score = legal.empty() && gs.in_check() ? -MATE : 0;
+      return {none};
+    }
+
+    // until the first iteration is completed: the first root moves
+    const int count = std::min(multiPV, root.size());
+    std::vector<SearchResult> lines(count);
+    for (int k = 0; k < count; ++k) {
+      lines[k].bestMove = root[k];
+      lines[k].pv = {root[k]};
+      lines[k].score = Eval::evaluate(gs, *params);
+    }
+
+    keys[0] = Zobrist::hash(gs);
+    const int maxDepth = limits.depth > 0 ? std::min(limits.depth, MAX_DEPTH)
+                                          : MAX_DEPTH;
+    for (int depth = 1; depth <= maxDepth && !limits.stopped(); ++depth) {
+      std::vector<SearchResult> next;
+      rootExcluded.resize(limits.excluded.size());
+      for (int k = 0; k < count && !stopped; ++k) {
+        const int score = aspiration(gs, depth, lines[k].score);
+        if (stopped)
+          break;
+        SearchResult r;
+        r.score = score;
+        r.depth = depth;
+        for (int i = 0; i < pvLength[0]; ++i)
+          r.pv.push_back(Move::from_raw(pvTable[0][i]));
+        r.bestMove = r.pv.front();
+        rootExcluded.push_back(r.bestMove->raw());
+        next.push_back(std::move(r));
+      }
+      // the depth interrupted is thrown away
+      if (stopped)
+        break;
+      completed = depth;
+      std::stable_sort(next.begin(), next.end(),
+                       [](const SearchResult &a, const SearchResult &b) {
+                         return a.score > b.score;
+                       });
+      lines = std::move(next);
+      // a mate found within the depth can't get better
+      const int best = std::abs(lines.front().score);
+      if (count == 1 && best > TranspositionTable::MATE_BOUND &&
+          MATE - best <= depth)
+        break;
+    }
+
+    for (SearchResult &r : lines)
+      r.nodes = searchNodes;
+    _nodes += searchNodes;
+    return lines;
+  }
+
+  inline bool is_excluded(const Move &m) const {
+    return std::find(rootExcluded.begin(), rootExcluded.end(), m.raw()) !=
+           rootExcluded.end();
+  }
+
+  // Count a node and check the limits (the stop flag every 1024 nodes)
+  inline bool should_stop() {
+    ++searchNodes;
+    if (!stopped && (searchNodes & 1023) == 0 && limits->stopped())
+      stopped = true;
+    if (!stopped && limits->nodes && completed &&
+        searchNodes >= limits->nodes)
+      stopped = true;
+    return stopped;
+  }
+
+  // Search at depth with a window around the score of the previous
+  // iteration, widened on a fail
+  inline int aspiration(const GameState &gs, int depth, int previous) {
+    int delta = 25;
+    int alpha = -INF, beta = INF;
+    if (depth >= 4) {
+      alpha = std::max(previous - delta, -INF);
+      beta = std::min(previous + delta, INF);
+    }
+    while (true) {
+      const int score = negamax(gs, depth, alpha, beta, 0, true);
+      if (stopped)
+        return 0;
+      if (score <= alpha && alpha > -INF)
+        alpha = std::max(score - delta, -INF);
+      else if (score >= beta && beta < INF)
+        beta = std::min(score + delta, INF);
+      else
+        return score;
+      delta *= 2;
+    }
+  }
+
+  inline int negamax(const GameState &gs, int depth, int alpha, int beta,
+                     int ply, bool nullAllowed) {
+    pvLength[ply] = ply;
+    const bool inCheck = gs.in_check();
+    if (inCheck)
+      ++depth;
+    if (depth <= 0)
+      return qsearch(gs, alpha, beta, ply);
+    if (should_stop())
+      return 0;
+    if (ply >= MAX_PLY)
+      return Eval::evaluate(gs, *params);
+
+    if (ply > 0 && is_draw(gs, ply))
+      return 0;
+
+    const bool pvNode = beta - alpha > 1;
+    const uint64_t key = keys[ply];
+    uint16_t ttMove = 0;
+    if (const auto *e = tt.probe(key)) {
+      ttMove = e->move;
+      const int score = TranspositionTable::score(*e, ply);
+      if (!pvNode && ply > 0 && e->depth >= depth &&
+          (e->bound == TranspositionTable::EXACT ||
+           (e->bound == TranspositionTable::LOWER && score >= beta) ||
+           (e->bound == TranspositionTable::UPPER && score <= alpha)))
+        return score;
+    }
+
+    // null move: if passing still fails high the move is not needed
+    if (!pvNode && !inCheck && nullAllowed && depth >= 3 && ply > 0 &&
+        has_pieces(gs) && Eval::evaluate(gs, *params) >= beta) {
+      GameState next = gs;
+      next.make_move(NULL_MOVE);
+      keys[ply + 1] = Zobrist::update(key, gs, next);
+      const int r = depth >= 6 ? 3 : 2;
+      const int score =
+          -negamax(next, depth - 1 - r, -beta, -beta + 1, ply + 1, false);
+      if (stopped)
+        return 0;
+      if (score >= beta)
+        return score > TranspositionTable::MATE_BOUND ? beta : score;
+    }
+
+    MoveList moves = MoveGen::generate(gs);
+    std::array<int, MoveList::CAPACITY> scores;
+    score_moves(gs, moves, scores, ttMove, ply);
+
+    const int alphaStart = alpha;
+    int best = -INF, legal = 0;
+    uint16_t bestMove = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+      pick(moves, scores, i);
+      const Move m = moves[i];
+      if (ply == 0 && is_excluded(m))
+        continue;
+      GameState next = gs;
+      next.make_move(m);
+      if (MoveGen::exposed(next))
+        continue;
+      ++legal;
+      keys[ply + 1] = Zobrist::update(key, gs, next);
+
+      const bool quiet = is_quiet(gs, m);
+      int score;
+      if (legal == 1) {
+        score = -negamax(next, depth - 1, -beta, -alpha, ply + 1, true);
+      } else {
+        // late quiet moves are searched at a reduced depth first
+        int r = 0;
+        if (depth >= 3 && legal > 3 && quiet && !inCheck && !next.in_check())
+          r = std::min(legal > 12 ? 2 : 1, depth - 2);
+        score = -negamax(next, depth - 1 - r, -alpha - 1, -alpha, ply + 1,
+                         true);
+        if (score > alpha && r)
+          score =
+              -negamax(next, depth - 1, -alpha - 1, -alpha, ply + 1, true);
+        if (score > alpha && score < beta)
+          score = -negamax(next, depth - 1, -beta, -alpha, ply + 1, true);
+      }
+      if (stopped)
+        return 0;
+
+      if (score <= best)
+        continue;
+      best = score;
+      bestMove = m.raw();
+      if (score <= alpha)
+        continue;
+      alpha = score;
+      update_pv(ply, m);
+      if (score >= beta) {
+        if (quiet)
+          update_quiet(gs, m, depth, ply);
+        break;
+      }
+    }
+
+    if (legal == 0) // checkmate or stalemate (or all root moves excluded)
+      return inCheck ? -MATE + ply : 0;
+
+    // the root without some of its moves is not the position
+    if (ply == 0 && !rootExcluded.empty())
+      return best;
+    tt.store(key, bestMove, best, depth,
+             best >= beta         ? TranspositionTable::LOWER
+             : alpha > alphaStart ? TranspositionTable::EXACT
+                                  : TranspositionTable::UPPER,
+             ply);
+    return best;
+  }
+
+  // Only the captures (all the moves if in check) until the position is
+  // quiet, the side to move can always stand pat if not in check
+  inline int qsearch(const GameState &gs, int alpha, int beta, int ply) {
+    pvLength[ply] = ply;
+    if (should_stop())
+      return 0;
+    if (ply >= MAX_PLY)
+      return Eval::evaluate(gs, *params);
+
+    const bool inCheck = gs.in_check();
+    int best = -INF;
+    if (!inCheck) {
+      best = Eval::evaluate(gs, *params);
+      if (best >= beta)
+        return best;
+      alpha = std::max(alpha, best);
+    }
+
+    MoveList moves =
+        MoveGen::generate(gs, inCheck ? MoveGen::ALL : MoveGen::CAPTURES);
+    std::array<int, MoveList::CAPACITY> scores;
+    score_moves(gs, moves, scores, 0, ply);
+
+    int legal = 0;
+    for (int i = 0; i < moves.size(); ++i) {
+      pick(moves, scores, i);
+      const Move m = moves[i];
+      GameState next = gs;
+      next.make_move(m);
+      if (MoveGen::exposed(next))
+        continue;
+      ++legal;
+      const int score = -qsearch(next, -beta, -alpha, ply + 1);
+      if (stopped)
+        return 0;
+      if (score <= best)
+        continue;
+      best = score;
+      if (score > alpha) {
+        alpha = score;
+        update_pv(ply, m);
+        if (score >= beta)
+          break;
+      }
+    }
+
+    if (inCheck && legal == 0)
+      return -MATE + ply;
+    return best;
+  }
+
+  // 50 moves rule or a repetition of a position of the search
+  inline bool is_draw(const GameState &gs, int ply) const {
+    if (gs.halfMoveClock() >= 100)
+      return true;
+    for (int i = ply - 2; i >= 0 && i >= ply - gs.halfMoveClock(); i -= 2)
+      if (keys[i] == keys[ply])
+        return true;
+    return false;
+  }
+
+  // the side to move has pieces other than pawns (no zugzwang for the null
+  // move)
+  static inline bool has_pieces(const GameState &gs) {
+    const Board &b = gs.board();
+    const Piece::Color us = gs.turn();
+    return b.occupancy(us) != (b.bitboard(us, Piece::Type::PAWN) |
+                               b.bitboard(us, Piece::Type::KING));
+  }
+
+  // Not a capture and not a promotion (castling is the king on its own rook)
+  static inline bool is_quiet(const GameState &gs, const Move &m) {
+    switch (m.type()) {
+    case Move::Type::CASTLING:
+      return true;
+    case Move::Type::NORMAL:
+    case Move::Type::DOUBLE_PAWN_PUSH:
+      return !gs.board().piece_at(m.to());
+    default:
+      return false;
+    }
+  }
+
+  inline void score_moves(const GameState &gs, const MoveList &moves,
+                          std::array<int, MoveList::CAPACITY> &scores,
+                          uint16_t ttMove, int ply) const {
+    const Board &b = gs.board();
+    for (int i = 0; i < moves.size(); ++i) {
+      const Move m = moves[i];
+      int &s = scores[i];
+      if (m.raw() == ttMove)
+        s = 1 << 30;
+      else if (m == Move::Type::PROMOTION_QUEEN)
+        s = (1 << 29) + b.piece_at(m.to()).type();
+      else if (!is_quiet(gs, m)) {
+        // MVV-LVA: the most valuable victim by the least valuable attacker
+        const int victim = m == Move::Type::EN_PASSANT
+                               ? Piece::Type::PAWN
+                               : b.piece_at(m.to()).type();
+        s = (1 << 28) + victim * 8 - b.piece_at(m.from()).type();
+        if (m != Move::Type::NORMAL) // under promotions last
+          s = -(1 << 28) + victim;
+      } else if (m.raw() == killers[ply][0])
+        s = (1 << 27) + 1;
+      else if (m.raw() == killers[ply][1])
+        s = 1 << 27;
+      else
+        s = history[gs.turn()][m.from()][m.to()];
+    }
+  }
+
+  // Move the best move of [i, size) in i (selection sort, a cutoff usually
+  // comes before the end)
+  static inline void pick(MoveList &moves,
+                          std::array<int, MoveList::CAPACITY> &scores, int i) {
+    int best = i;
+    for (int j = i + 1; j < moves.size(); ++j)
+      if (scores[j] > scores[best])
+        best = j;
+    moves.swap(i, best);
+    std::swap(scores[i], scores[best]);
+  }
+
+  inline void update_pv(int ply, const Move &m) {
+    pvTable[ply][ply] = m.raw();
+    for (int i = ply + 1; i < pvLength[ply + 1]; ++i)
+      pvTable[ply][i] = pvTable[ply + 1][i];
+    pvLength[ply] = std::max(pvLength[ply + 1], ply + 1);
+  }
+
+  inline void update_quiet(const GameState &gs, const Move &m, int depth,
+                           int ply) {
+    if (killers[ply][0] != m.raw()) {
+      killers[ply][1] = killers[ply][0];
+      killers[ply][0] = m.raw();
+    }
+    int &h = history[gs.turn()][m.from()][m.to()];
+    h += depth * depth;
+    if (h > (1 << 20)) // keep the history below the killers
+      for (auto &from : history[gs.turn()])
+        for (int &v : from)
+          v /= 2;
+  }
+};
@@ -0,0 +1,384 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cli.hpp"
+#include "gamestate.hpp"
+#include "search.hpp"
+#include "threadpool.hpp"
+
+/*
+Analysis server on a local Unix socket
+
+  tiresia server [--socket /tmp/tiresia.sock] [--instances N] [--depth N]
+                 [--nodes N] [--pin] [--params params.txt] [--hash MB]
+
+The server keeps a pool of engine instances (one per worker of the pool),
+every instance has its own GameState and Searcher (with a transposition table
+of --hash MB, built by its worker on the first request), the read only tables
+(the EvalParams, the attack tables, ...) are shared by all the instances.
+The requests of all the clients are scheduled on the instances, every client
+can have many requests running at the same time.
+Every client has a reader thread and a writer thread, the replies are queued
+for the writer so an instance never waits for a slow client.
+
+Protocol (one command per line, the replies can arrive in any order):
+
+  go <id> fen <6 FEN fields> [depth N] [nodes N]
+      -> result <id> score cp <S> depth <D> nodes <N> bestmove <M> [pv ...]
+      -> cancelled <id>
+      -> error <id> <message>
+  cancel <id>   stop the request <id> (running or queued)
+  quit          close the connection
+  shutdown      stop the server
+*/
+
+class Server {
+public:
+  struct Options {
+    std::string socket = "/tmp/tiresia.sock";
+    std::size_t instances = ThreadPool::default_threads();
+    SearchLimits limits{.depth = 8}; // default limits of a request
+    bool pin = false;
+    std::size_t hash = TranspositionTable::DEFAULT_MB; // by instance
+  };
+
+  static inline Options options(const Args &args) {
+    Options opt;
+    opt.socket = args.get("socket", opt.socket);
+    opt.instances = args.get_int("instances", opt.instances);
+    opt.limits.depth = args.get_int("depth", opt.limits.depth);
+    opt.limits.nodes = args.get_int("nodes", opt.limits.nodes);
+    if (args.has("params"))
+      opt.limits.params = std::make_shared<const EvalParams>(
+          EvalParams::load(args.get("params")));
+    opt.pin = args.has("pin");
+    opt.hash = args.get_int("hash", opt.hash);
+    return opt;
+  }
+
+  static inline int run(const Args &args) {
+    const Options opt = options(args);
+    Server server(opt);
+    std::fprintf(stderr, "server: %zu instances listening on %s\n",
+                 server.pool.size(), opt.socket.c_str());
+    server.serve();
+    return 0;
+  }
+
+  // Create the socket (an old socket at the same path is replaced, any other
+  // file is an error and is left alone)
+  inline explicit Server(const Options &opt)
+      : opt(opt), pool(opt.instances, opt.pin), instances(pool.size()) {
+    sockaddr_un addr = address(opt.socket);
+    struct stat st;
+    if (::lstat(opt.socket.c_str(), &st) == 0) {
+      if (!S_ISSOCK(st.st_mode))
+        throw std::runtime_error("server: " + opt.socket +
+                                 " exists and is not a socket");
+      ::unlink(opt.socket.c_str());
+    }
+    listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0)
+      throw std::runtime_error("server: cannot create the socket");
+    if (::bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) !=
+            0 ||
+        ::listen(listener, 64) != 0 || ::lstat(opt.socket.c_str(), &st) != 0) {
+      ::close(listener);
+      throw std::runtime_error("server: cannot listen on " + opt.socket);
+    }
+    socketFile = {st.st_dev, st.st_ino};
+  }
+
+  inline ~Server() {
+    shutdown();
+    {
+      std::unique_lock lock(mutex);
+      idle.wait(lock, [this] { return connections.empty(); });
+    }
+    pool.wait();
+    ::close(listener);
+    // only our socket, the path may have been reused since
+    struct stat st;
+    if (::lstat(opt.socket.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) &&
+        std::pair(st.st_dev, st.st_ino) == socketFile)
+      ::unlink(opt.socket.c_str());
+  }
+
+  Server(const Server &) = delete;
+  Server &operator=(const Server &) = delete;
+
+  // Accept the clients until shutdown()
+  inline void serve() {
+    while (!stopped) {
+      const int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0) {
+        if (stopped)
+          break;
+        continue;
+      }
+      auto c = std::make_shared<Connection>(fd);
+      std::lock_guard lock(mutex);
+      if (stopped) {
+        c->close();
+        break;
+      }
+      connections.insert(c);
+      std::thread([this, c] { read(c); }).detach();
+    }
+  }
+
+  // Stop accepting clients, disconnect them and cancel their requests
+  inline void shutdown() {
+    std::lock_guard lock(mutex);
+    if (stopped.exchange(true))
+      return;
+    ::shutdown(listener, SHUT_RDWR); // wake up accept()
+    for (auto &c : connections)
+      c->close();
+  }
+
+  // Address of a Unix socket (throws if the path is too long)
+  static inline sockaddr_un address(const std::string &path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+      throw std::runtime_error("server: socket path too long");
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return addr;
+  }
+
+private:
+  using Flag = std::shared_ptr<std::atomic<bool>>;
+
+  // State of an engine instance, only used by its worker
+  struct Instance {
+    Searcher searcher;
+    GameState gs;
+
+    inline explicit Instance(std::size_t ttEntries) : searcher(ttEntries) {}
+  };
+
+  struct Connection {
+    int fd;
+    std::mutex mutex;
+    std::map<std::string, Flag> requests; // cancel flag of each request id
+    std::deque<std::string> outbox;       // lines not yet written
+    std::condition_variable pending;      // signaled on send and close
+    std::string buffer;                   // data read but not yet used
+    std::atomic<bool> closed = false;
+    bool draining = false; // the writer stops when the outbox is empty
+
+    inline explicit Connection(int fd) : fd(fd) {}
+    inline ~Connection() { ::close(fd); }
+
+    // Queue a line for the writer (never waits for the client)
+    inline void send(const std::string &line) {
+      std::lock_guard lock(mutex);
+      if (closed)
+        return;
+      outbox.push_back(line + '\n');
+      pending.notify_one();
+    }
+
+    // Write the queued lines until close() or drain() (the writer thread)
+    inline void write() {
+      std::unique_lock lock(mutex);
+      while (true) {
+        pending.wait(lock, [this] {
+          return closed || draining || !outbox.empty();
+        });
+        if (closed || outbox.empty())
+          return;
+        const std::string data = std::move(outbox.front());
+        outbox.pop_front();
+        lock.unlock();
+        for (std::size_t sent = 0; sent < data.size();) {
+          const ssize_t n = ::send(fd, data.data() + sent,
+                                   data.size() - sent, MSG_NOSIGNAL);
+          if (n <= 0) { // the client is gone
+            close();
+            return;
+          }
+          sent += static_cast<std::size_t>(n);
+        }
+        lock.lock();
+      }
+    }
+
+    // Read a line, false when the client is gone
+    inline bool read_line(std::string &line) {
+      std::size_t end;
+      while ((end = buffer.find('\n')) == std::string::npos) {
+        char chunk[4096];
+        const ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0)
+          return false;
+        buffer.append(chunk, static_cast<std::size_t>(n));
+      }
+      line = buffer.substr(0, end);
+      buffer.erase(0, end + 1);
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      return true;
+    }
+
+    // Let the writer write the lines already queued and stop
+    inline void drain() {
+      std::lock_guard lock(mutex);
+      draining = true;
+      pending.notify_all();
+    }
+
+    // Cancel all the requests and wake up the reader and the writer
+    inline void close() {
+      closed = true;
+      ::shutdown(fd, SHUT_RDWR);
+      std::lock_guard lock(mutex);
+      for (auto &[id, flag] : requests)
+        *flag = true;
+      pending.notify_all();
+    }
+  };
+
+  const Options opt;
+  ThreadPool pool;
+  // by worker, created by the worker on its first request
+  std::vector<std::unique_ptr<Instance>> instances;
+  int listener = -1;
+  std::pair<dev_t, ino_t> socketFile; // device and inode of the socket
+
+  std::mutex mutex;
+  std::atomic<bool> stopped = false;
+  std::condition_variable idle; // signaled when a connection ends
+  // open connections, each one has its own (detached) reader thread
+  std::set<std::shared_ptr<Connection>> connections;
+
+  inline void read(const std::shared_ptr<Connection> &c) {
+    std::thread writer([c] { c->write(); });
+    std::string line;
+    while (!c->closed && c->read_line(line)) {
+      std::istringstream ss(line);
+      std::string command, id;
+      ss >> command >> id;
+      if (command == "go")
+        go(c, id, ss);
+      else if (command == "cancel")
+        cancel(c, id);
+      else if (command == "quit")
+        break;
+      else if (command == "shutdown") {
+        shutdown();
+        break;
+      } else if (!command.empty())
+        c->send("error " + id + " unknown command " + command);
+    }
+    // the replies already queued (errors, ...) are still written
+    c->drain();
+    writer.join();
+    c->close();
+    std::lock_guard lock(mutex);
+    connections.erase(c);
+    idle.notify_all();
+  }
+
+  inline void go(const std::shared_ptr<Connection> &c, const std::string &id,
+                 std::istringstream &ss) {
+    std::string token, fen;
+    SearchLimits limits = opt.limits;
+    try {
+      if (id.empty() || !(ss >> token) || token != "fen")
+        throw std::runtime_error("expected: go <id> fen <fen>");
+      for (int i = 0; i < 6 && ss >> token; ++i)
+        fen += (i ? " " : "") + token;
+      while (ss >> token) {
+        std::string value;
+        if (!(ss >> value))
+          throw std::runtime_error("missing value of " + token);
+        if (token == "depth")
+          limits.depth = std::stoi(value);
+        else if (token == "nodes")
+          limits.nodes = std::stoull(value);
+        else
+          throw std::runtime_error("unknown limit " + token);
+      }
+      (void)GameState(fen); // validate now, the client gets the error at once
+    } catch (const std::exception &e) {
+      c->send("error " + id + ' ' + e.what());
+      return;
+    }
+
+    Flag cancelled = std::make_shared<std::atomic<bool>>(false);
+    bool duplicate;
+    {
+      std::lock_guard lock(c->mutex);
+      duplicate = !c->requests.try_emplace(id, cancelled).second;
+    }
+    if (duplicate) {
+      c->send("error " + id + " request already running");
+      return;
+    }
+
+    pool.submit([this, c, id, fen, limits, cancelled](std::size_t w) mutable {
+      std::string reply = "cancelled " + id;
+      if (!*cancelled) {
+        if (!instances[w])
+          instances[w] = std::make_unique<Instance>(
+              TranspositionTable::entries(opt.hash));
+        Instance &instance = *instances[w];
+        instance.gs = GameState(fen);
+        limits.stop = cancelled.get();
+        const SearchResult r = instance.searcher.search(instance.gs, limits);
+        if (!*cancelled)
+          reply = format(id, r);
+      }
+      {
+        std::lock_guard lock(c->mutex);
+        c->requests.erase(id);
+      }
+      c->send(reply);
+    });
+  }
+
+  inline void cancel(const std::shared_ptr<Connection> &c,
+                     const std::string &id) {
+    std::lock_guard lock(c->mutex);
+    auto it = c->requests.find(id);
+    if (it != c->requests.end())
+      *it->second = true;
+  }
+
+  static inline std::string format(const std::string &id,
+                                   const SearchResult &r) {
+    std::string s = "result " + id;
+    s += " score cp " + std::to_string(r.score);
+    s += " depth " + std::to_string(r.depth);
+    s += " nodes " + std::to_string(r.nodes);
+    s += " bestmove " + (r.bestMove ? r.bestMove->to_string() : "(none)");
+    if (!r.pv.empty()) {
+      s += " pv";
+      for (const Move &m : r.pv)
+        s += ' ' + m.to_string();
+    }
+    return s;
+  }
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+/*
+Sequential probability ratio test on the results of game pairs
+ref: https://www.chessprogramming.org/Sequential_Probability_Ratio_Test
+
+The games are played in pairs (same opening, colors swapped), so the sample
+is the score of the pair and the results are counted in a pentanomial
+distribution:
+
+  | Index | Pair score | Example   |
+  | ----- | ---------- | --------- |
+  | 0     | 0          | LL        |
+  | 1     | 0.25       | LD        |
+  | 2     | 0.5        | WL or DD  |
+  | 3     | 0.75       | WD        |
+  | 4     | 1          | WW        |
+
+The log likelihood ratio is the normal approximation of the GSPRT:
+  LLR = N * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance)
+where s0 and s1 are the expected scores of elo0 (H0) and elo1 (H1).
+The mean and the variance are estimated with a prior of half a pair in every
+bucket: with few pairs (all wins, all draws) the observed variance is 0 or
+close to 0 and the LLR would explode. No decision is taken before MIN_PAIRS
+pairs.
+*/
+
+class Sprt {
+public:
+  using Pentanomial = std::array<uint64_t, 5>;
+
+  enum Result { CONTINUE, H0, H1 }; // H0 = not better than elo0
+
+  static constexpr double PRIOR = 0.5; // pairs added to every bucket
+  static constexpr uint64_t MIN_PAIRS = 20;
+
+  inline Sprt(double elo0 = 0, double elo1 = 5, double alpha = 0.05,
+              double beta = 0.05)
+      : _elo0(elo0), _elo1(elo1), _lower(std::log(beta / (1 - alpha))),
+        _upper(std::log((1 - beta) / alpha)) {}
+
+  // Expected score of an elo difference (logistic model)
+  static inline double score(double elo) {
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+  }
+
+  // Elo difference of an expected score
+  static inline double elo(double score) {
+    score = std::clamp(score, 1e-6, 1 - 1e-6);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+  }
+
+  static inline uint64_t pairs(const Pentanomial &p) {
+    return p[0] + p[1] + p[2] + p[3] + p[4];
+  }
+
+  // Mean and variance of the pair score (with PRIOR pairs in every bucket)
+  static inline std::array<double, 2> mean_variance(const Pentanomial &p) {
+    double n = 0, mean = 0;
+    for (int i = 0; i < 5; ++i) {
+      n += p[i] + PRIOR;
+      mean += (p[i] + PRIOR) * i / 4.0;
+    }
+    mean /= n;
+    double variance = 0;
+    for (int i = 0; i < 5; ++i) {
+      const double d = i / 4.0 - mean;
+      variance += (p[i] + PRIOR) * d * d;
+    }
+    return {mean, variance / n};
+  }
+
+  inline double llr(const Pentanomial &p) const {
+    const auto [mean, variance] = mean_variance(p);
+    const double s0 = score(_elo0), s1 = score(_elo1);
+    return pairs(p) * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+  }
+
+  inline Result test(const Pentanomial &p) const {
+    if (pairs(p) < MIN_PAIRS)
+      return CONTINUE;
+    const double r = llr(p);
+    return r >= _upper ? H1 : r <= _lower ? H0 : CONTINUE;
+  }
+
+  // Elo difference with the 95% confidence interval
+  static inline std::array<double, 2> elo_error(const Pentanomial &p) {
+    const auto [mean, variance] = mean_variance(p);
+    const double n = static_cast<double>(std::max<uint64_t>(pairs(p), 1));
+    const double error = 1.96 * std::sqrt(variance / n);
+    return {elo(mean), (elo(mean + error) - elo(mean - error)) / 2};
+  }
+
+  constexpr double lower() const { return _lower; }
+  constexpr double upper() const { return _upper; }
+  constexpr double elo0() const { return _elo0; }
+  constexpr double elo1() const { return _elo1; }
+
+private:
+  double _elo0, _elo1;
+  double _lower, _upper; // bounds of the LLR
+};
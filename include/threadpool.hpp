@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "largepage.hpp"
+
+/*
+Work stealing thread pool
+
+Every worker has its own queue, the tasks are distributed round robin on the
+queues. A worker takes the tasks from the front of its queue and, when it is
+empty, steals from the back of the queues of the other workers.
+
+A task receives the index of the worker that runs it, so the caller can keep
+per worker state (a Searcher, a buffer, ...) in a vector indexed by it without
+any lock.
+*/
+
+class ThreadPool {
+public:
+  using Task = std::function<void(std::size_t worker)>;
+
+  inline explicit ThreadPool(std::size_t threads = default_threads(),
+                             bool pin = false)
+      : queues(std::max<std::size_t>(threads, 1)) {
+    for (auto &q : queues)
+      q = std::make_unique<Queue>();
+    workers.reserve(queues.size());
+    for (std::size_t i = 0; i < queues.size(); ++i)
+      workers.emplace_back([this, i, pin] {
+        if (pin)
+          LargePage::pin_current_thread(i);
+        loop(i);
+      });
+  }
+
+  // Wait all the submitted tasks then stop the workers
+  inline ~ThreadPool() {
+    wait();
+    {
+      std::lock_guard lock(mutex);
+      stop = true;
+    }
+    cv.notify_all();
+    for (auto &w : workers)
+      w.join();
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  static inline std::size_t default_threads() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  constexpr std::size_t size() const { return queues.size(); }
+
+  inline void submit(Task task) {
+    // count the task before it is visible, so a worker never decrements
+    // queued below zero
+    {
+      std::lock_guard lock(mutex);
+      ++queued;
+      ++pending;
+    }
+    Queue &q = *queues[next++ % queues.size()];
+    {
+      std::lock_guard lock(q.mutex);
+      q.tasks.push_back(std::move(task));
+    }
+    cv.notify_one();
+  }
+
+  // Block until all the submitted tasks are finished
+  inline void wait() {
+    std::unique_lock lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+  }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+  std::atomic<std::size_t> next = 0; // queue of the next submitted task
+
+  std::mutex mutex;
+  std::condition_variable cv;   // signaled when a task is queued or on stop
+  std::condition_variable done; // signaled when pending reaches 0
+  std::size_t queued = 0;       // tasks in the queues
+  std::size_t pending = 0;      // tasks queued or running
+  bool stop = false;
+
+  inline bool pop(std::size_t i, Task &task) {
+    // own queue first (front)
+    {
+      Queue &q = *queues[i];
+      std::lock_guard lock(q.mutex);
+      if (!q.tasks.empty()) {
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        return true;
+      }
+    }
+    // then steal from the others (back)
+    for (std::size_t k = 1; k < queues.size(); ++k) {
+      Queue &q = *queues[(i + k) % queues.size()];
+      std::lock_guard lock(q.mutex);
+      if (!q.tasks.empty()) {
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  inline void loop(std::size_t i) {
+    Task task;
+    while (true) {
+      {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [this] { return queued > 0 || stop; });
+        if (queued == 0 && stop)
+          return;
+      }
+      // another worker may have taken the task in the meantime
+      if (!pop(i, task))
+        continue;
+      {
+        std::lock_guard lock(mutex);
+        --queued;
+      }
+
+      task(i);
+      task = nullptr;
+
+      std::lock_guard lock(mutex);
+      if (--pending == 0)
+        done.notify_all();
+    }
+  }
+};
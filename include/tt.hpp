@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "largepage.hpp"
+#include "move.hpp"
+
+/*
+Transposition table: the result of the positions already searched, indexed
+by their Zobrist key (always replace)
+
+  | Field | Bits | Note                                        |
+  | ----- | ---- | ------------------------------------------- |
+  | key   | 64   | full key, checked on probe                  |
+  | move  | 16   | best move (Move::raw, 0 = none)             |
+  | score | 16   | mate scores relative to the node, see below |
+  | depth | 8    |                                             |
+  | bound | 8    | EXACT, LOWER (fail high), UPPER (fail low)  |
+
+The mate scores are stored as distance from the node and not from the root,
+so the same entry is valid at any ply.
+The entries live in a LargeTable (huge pages), the size is rounded down to a
+power of 2 so the index is a mask of the key. The table is zeroed by threads
+threads (pinned if pin, see LargePage::first_touch): a table built by a
+pinned search thread is on the NUMA node of that thread.
+*/
+
+class TranspositionTable {
+public:
+  enum Bound : uint8_t { NONE, EXACT, LOWER, UPPER };
+
+  struct Entry {
+    uint64_t key;
+    uint16_t move;
+    int16_t score;
+    int8_t depth;
+    Bound bound;
+  };
+  static_assert(sizeof(Entry) == 16);
+
+  // scores above this are mates (see Searcher::MATE)
+  static constexpr int MATE_BOUND = 30000;
+
+  static constexpr std::size_t DEFAULT_ENTRIES = 1 << 17; // 2 MB
+  static constexpr std::size_t DEFAULT_MB = 2;
+
+  // Entries in mb megabytes (the hash size of the options)
+  static constexpr std::size_t entries(std::size_t mb) {
+    return mb * 1024 * 1024 / sizeof(Entry);
+  }
+
+  inline explicit TranspositionTable(std::size_t entries = DEFAULT_ENTRIES,
+                                     std::size_t threads = 1,
+                                     bool pin = false) {
+    resize(entries, threads, pin);
+  }
+
+  inline void resize(std::size_t entries, std::size_t threads = 1,
+                     bool pin = false) {
+    entries = std::bit_floor(std::max<std::size_t>(entries, 1));
+    table.resize(entries, threads, pin);
+    mask = entries - 1;
+  }
+
+  inline void clear() { table.clear(); }
+
+  // The entry of the key, nullptr if there is none
+  inline const Entry *probe(uint64_t key) const {
+    const Entry &e = table[key & mask];
+    return e.bound != NONE && e.key == key ? &e : nullptr;
+  }
+
+  inline void store(uint64_t key, uint16_t move, int score, int depth,
+                    Bound bound, int ply) {
+    Entry &e = table[key & mask];
+    // keep the move of the position if the new result has none
+    if (!move && e.key == key)
+      move = e.move;
+    e = Entry{key, move, static_cast<int16_t>(to_tt(score, ply)),
+              static_cast<int8_t>(depth), bound};
+  }
+
+  // Score of an entry at ply
+  static constexpr int score(const Entry &e, int ply) {
+    return e.score > MATE_BOUND    ? e.score - ply
+           : e.score < -MATE_BOUND ? e.score + ply
+                                   : e.score;
+  }
+
+  constexpr std::size_t size() const { return table.size(); }
+
+private:
+  LargeTable<Entry> table;
+  uint64_t mask = 0;
+
+  static constexpr int to_tt(int score, int ply) {
+    return score > MATE_BOUND    ? score + ply
+           : score < -MATE_BOUND ? score - ply
+                                 : score;
+  }
+};
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "cli.hpp"
+#include "datafile.hpp"
+#include "eval.hpp"
+#include "packed.hpp"
+#include "threadpool.hpp"
+
+/*
+Texel tuning of the evaluation parameters
+ref: https://www.chessprogramming.org/Texel%27s_Tuning_Method
+
+  tiresia tune --input data.bin [--epochs N] [--lr X] [--k K] [--threads T]
+               [--output params.txt]
+
+The output is the file of EvalParams::load, read with --params (analyse,
+datagen, server) or the EvalFile UCI option.
+
+The evaluation is linear in its parameters (EvalParams), so every position is
+stored once as the list of its features: (parameter, coefficient) with the
+coefficient = white pieces - black pieces using that parameter.
+The positions are kept in a struct of arrays, the features of position i are
+index[begin[i]..begin[i + 1]) and coef[begin[i]..begin[i + 1]).
+
+The loss is the mean of (result - sigmoid(eval))^2 with
+  sigmoid(eval) = 1 / (1 + 10^(-K * eval / 400))
+and it is minimized with Adam. Every epoch the workers compute the gradient
+of their own range of positions in a local vector, then the vectors are
+summed.
+Without --k the scale K is fitted first: the K that minimizes the loss of
+the starting parameters (the eval is not changed by the fit, only the
+mapping of the centipawns to the expected result).
+*/
+
+class Tuner {
+public:
+  // Parameter index: type * STRIDE + 0 = piece value, type * STRIDE + 1 + sq
+  // = piece square table
+  static constexpr int STRIDE = 65;
+  static constexpr int PARAMS = Piece::Type::PIECE_NB * STRIDE;
+
+  struct Options {
+    std::string input;
+    std::string output; // empty = stdout
+    int epochs = 1000;
+    double lr = 1.0; // centipawns per step
+    double k = 0; // 0 = fit K to the data
+    std::size_t threads = ThreadPool::default_threads();
+  };
+
+  // Struct of arrays of the positions
+  struct Dataset {
+    std::vector<uint64_t> begin{0}; // size() + 1 elements
+    std::vector<uint16_t> index;
+    std::vector<int8_t> coef;
+    std::vector<float> result; // 0 = black wins, 0.5 = draw, 1 = white wins
+
+    inline std::size_t size() const { return result.size(); }
+
+    // result from the white point of view (0 to 1)
+    inline void add(const PackedPosition &p, float white) {
+      int8_t features[PARAMS] = {};
+      p.for_each_piece([&](Square sq, Piece piece) {
+        const int sign = piece.is_white() ? 1 : -1;
+        const int rel = piece.is_white() ? sq.to_int() : sq.to_int() ^ 56;
+        features[piece.type() * STRIDE] += sign;
+        features[piece.type() * STRIDE + 1 + rel] += sign;
+      });
+      for (int i = 0; i < PARAMS; ++i)
+        if (features[i]) {
+          index.push_back(static_cast<uint16_t>(i));
+          coef.push_back(features[i]);
+        }
+      begin.push_back(static_cast<uint64_t>(index.size()));
+      result.push_back(white);
+    }
+
+    // the result of the data file is from the point of view of the side to
+    // move
+    inline void add(const PackedPosition &p) {
+      const int white = p.turn() == Piece::Color::WHITE ? p.result()
+                                                        : -p.result();
+      add(p, 0.5f + 0.5f * static_cast<float>(white));
+    }
+  };
+
+  static inline Options options(const Args &args) {
+    Options opt;
+    opt.input = args.get("input");
+    if (opt.input.empty())
+      throw std::runtime_error("tune: missing --input");
+    opt.output = args.get("output");
+    opt.epochs = args.get_int("epochs", opt.epochs);
+    opt.lr = std::stod(args.get("lr", std::to_string(opt.lr)));
+    opt.k = std::stod(args.get("k", std::to_string(opt.k)));
+    opt.threads = args.get_int("threads", opt.threads);
+    return opt;
+  }
+
+  static inline int run(const Args &args) {
+    const Options opt = options(args);
+
+    Dataset data;
+    {
+      DataReader reader(opt.input);
+      data.result.reserve(reader.size());
+      reader.for_each([&](const PackedPosition &p) { data.add(p); });
+    }
+    std::fprintf(stderr, "tune: %zu positions\n", data.size());
+    if (data.size() == 0)
+      throw std::runtime_error("tune: no positions");
+
+    Tuner tuner(data, opt);
+    if (opt.k <= 0) {
+      tuner.fit_k(to_vector(Eval::DEFAULT_PARAMS));
+      std::fprintf(stderr, "tune: K %.4f\n", tuner.k);
+    }
+    const EvalParams params = tuner.tune(Eval::DEFAULT_PARAMS);
+
+    std::FILE *out = stdout;
+    if (!opt.output.empty() && !(out = std::fopen(opt.output.c_str(), "w")))
+      throw std::runtime_error("tune: cannot open " + opt.output);
+    std::fprintf(out, "# tiresia tune, K %.4f, %zu positions\n", tuner.k,
+                 data.size());
+    params.save(out);
+    if (out != stdout)
+      std::fclose(out);
+    return 0;
+  }
+
+  // scale of the sigmoid (--k or fit_k)
+  double k;
+
+  inline Tuner(const Dataset &data, const Options &opt)
+      : k(opt.k > 0 ? opt.k : 1.0), data(data), opt(opt), pool(opt.threads),
+        gradients(pool.size(), std::vector<double>(PARAMS)),
+        losses(pool.size()) {}
+
+  inline EvalParams tune(const EvalParams &start) {
+    std::vector<double> theta = to_vector(start);
+    std::vector<double> m(PARAMS), v(PARAMS), grad(PARAMS);
+    constexpr double beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+
+    const auto begin = std::chrono::steady_clock::now();
+    for (int epoch = 1; epoch <= opt.epochs; ++epoch) {
+      const double loss = gradient(theta, grad);
+
+      for (int i = 0; i < PARAMS; ++i) {
+        if (!tunable(i))
+          continue;
+        m[i] = beta1 * m[i] + (1 - beta1) * grad[i];
+        v[i] = beta2 * v[i] + (1 - beta2) * grad[i] * grad[i];
+        const double mh = m[i] / (1 - std::pow(beta1, epoch));
+        const double vh = v[i] / (1 - std::pow(beta2, epoch));
+        theta[i] -= opt.lr * mh / (std::sqrt(vh) + eps);
+      }
+
+      if (epoch == 1 || epoch % 100 == 0 || epoch == opt.epochs) {
+        const double seconds = std::chrono::duration<double>(
+                                   std::chrono::steady_clock::now() - begin)
+                                   .count();
+        std::fprintf(stderr, "tune: epoch %d loss %.8f (%.1f s)\n", epoch,
+                     loss, seconds);
+      }
+    }
+    return to_params(theta);
+  }
+
+  // Compute the gradient of the loss in grad and return the loss
+  inline double gradient(const std::vector<double> &theta,
+                         std::vector<double> &grad) {
+    return pass(theta, &grad);
+  }
+
+  inline double loss(const std::vector<double> &theta) {
+    return pass(theta, nullptr);
+  }
+
+  // Set k to the K that minimizes the loss of theta (the loss is convex
+  // enough in K for a search on a grid refined around the best point) and
+  // return the loss
+  inline double fit_k(const std::vector<double> &theta) {
+    double best = 1.0, bestLoss = loss(theta);
+    double lo = 0.1, hi = 4.0;
+    for (int round = 0; round < 4; ++round) {
+      const double step = (hi - lo) / 10;
+      for (double x = lo; x <= hi + step / 2; x += step) {
+        k = x;
+        const double l = loss(theta);
+        if (l < bestLoss)
+          best = x, bestLoss = l;
+      }
+      lo = std::max(best - step, 0.01);
+      hi = best + step;
+    }
+    k = best;
+    return bestLoss;
+  }
+
+  static inline std::vector<double> to_vector(const EvalParams &p) {
+    std::vector<double> theta(PARAMS);
+    for (int t = 0; t < Piece::Type::PIECE_NB; ++t) {
+      theta[t * STRIDE] = p.pieceValue[t];
+      for (int sq = 0; sq < 64; ++sq)
+        theta[t * STRIDE + 1 + sq] = p.pst[t][sq];
+    }
+    return theta;
+  }
+
+  static inline EvalParams to_params(const std::vector<double> &theta) {
+    EvalParams p{};
+    for (int t = 0; t < Piece::Type::PIECE_NB; ++t) {
+      p.pieceValue[t] = static_cast<int>(std::lround(theta[t * STRIDE]));
+      for (int sq = 0; sq < 64; ++sq)
+        p.pst[t][sq] =
+            static_cast<int>(std::lround(theta[t * STRIDE + 1 + sq]));
+    }
+    return p;
+  }
+
+private:
+  const Dataset &data;
+  const Options &opt;
+  ThreadPool pool;
+  std::vector<std::vector<double>> gradients; // by worker
+  std::vector<double> losses;                 // by worker
+
+  // The king has no value (it is always on the board)
+  static constexpr bool tunable(int i) {
+    return i / STRIDE != Piece::Type::NO_PIECE &&
+           i != Piece::Type::KING * STRIDE;
+  }
+
+  // One pass on the positions: the loss, and its gradient in grad if it is
+  // not nullptr
+  inline double pass(const std::vector<double> &theta,
+                     std::vector<double> *grad) {
+    const std::size_t n = data.size();
+    const std::size_t per_task = (n + pool.size() - 1) / pool.size();
+    // derivative of the sigmoid argument (natural log) by the eval
+    const double scale = k * std::log(10.0) / 400.0;
+
+    for (std::size_t t = 0; t < pool.size(); ++t)
+      pool.submit([&, t](std::size_t worker) {
+        std::vector<double> &g = gradients[worker];
+        double loss = 0;
+        const std::size_t end = std::min(n, (t + 1) * per_task);
+        for (std::size_t i = t * per_task; i < end; ++i) {
+          const uint64_t b = data.begin[i], e = data.begin[i + 1];
+          double eval = 0;
+          for (uint64_t f = b; f < e; ++f)
+            eval += theta[data.index[f]] * data.coef[f];
+
+          const double s = 1.0 / (1.0 + std::exp(-scale * eval));
+          const double err = s - data.result[i];
+          loss += err * err;
+          if (!grad)
+            continue;
+          const double d = 2.0 * err * s * (1.0 - s) * scale;
+          for (uint64_t f = b; f < e; ++f)
+            g[data.index[f]] += d * data.coef[f];
+        }
+        losses[worker] += loss;
+      });
+    pool.wait();
+
+    // reduction of the thread local gradients
+    double loss = 0;
+    if (grad)
+      std::fill(grad->begin(), grad->end(), 0.0);
+    for (std::size_t w = 0; w < pool.size(); ++w) {
+      if (grad) {
+        for (int i = 0; i < PARAMS; ++i)
+          (*grad)[i] += gradients[w][i] / static_cast<double>(n);
+        std::fill(gradients[w].begin(), gradients[w].end(), 0.0);
+      }
+      loss += losses[w];
+      losses[w] = 0;
+    }
+    return loss / static_cast<double>(n);
+  }
+};
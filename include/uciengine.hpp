@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+/*
+An external UCI engine running in a child process, connected with 2 pipes
+ref: https://www.wbec-ridderkerk.nl/html/UCIProtocol.html
+
+  UciEngine e("./tiresia");
+  e.set_option("Hash", "16");
+  e.new_game();
+  auto r = e.go("position startpos moves e2e4", "nodes 10000");
+
+An engine that does not answer within the timeout (a whole go, or a single
+line for the other commands) is killed and the call throws. On close the
+engine has QUIT_TIMEOUT to exit after quit, then it is killed.
+*/
+
+class UciEngine {
+public:
+  struct GoResult {
+    std::string bestMove;    // "(none)" or "0000" if there is no legal move
+    std::optional<int> cp;   // last score in centipawns
+    std::optional<int> mate; // last score in moves to mate
+  };
+
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::chrono::milliseconds DEFAULT_TIMEOUT{10000};
+  static constexpr std::chrono::milliseconds QUIT_TIMEOUT{1000};
+
+  // command is run by /bin/sh, so it can have arguments
+  inline explicit UciEngine(
+      const std::string &command,
+      std::chrono::milliseconds timeout = DEFAULT_TIMEOUT)
+      : timeout(timeout) {
+    int to_child[2], from_child[2];
+    // close on exec: the engines started by other threads must not inherit
+    // the pipes
+    if (pipe2(to_child, O_CLOEXEC) != 0)
+      throw std::runtime_error("UciEngine: pipe failed");
+    if (pipe2(from_child, O_CLOEXEC) != 0) {
+      ::close(to_child[0]);
+      ::close(to_child[1]);
+      throw std::runtime_error("UciEngine: pipe failed");
+    }
+
+    pid = fork();
+    if (pid < 0) {
+      for (int fd : {to_child[0], to_child[1], from_child[0], from_child[1]})
+        ::close(fd);
+      throw std::runtime_error("UciEngine: fork failed");
+    }
+    if (pid == 0) { // child, dup2 clears close on exec
+      dup2(to_child[0], STDIN_FILENO);
+      dup2(from_child[1], STDOUT_FILENO);
+      execl("/bin/sh", "sh", "-c", command.c_str(),
+            static_cast<char *>(nullptr));
+      _exit(127);
+    }
+
+    ::close(to_child[0]);
+    ::close(from_child[1]);
+    in = fdopen(to_child[1], "w");
+    out = from_child[0];
+
+    // a dead engine must not kill the caller when it writes to the pipe
+    signal(SIGPIPE, SIG_IGN);
+
+    try {
+      if (!in)
+        throw std::runtime_error("UciEngine: fdopen failed");
+      send("uci");
+      for (std::string line; (line = read_line()) != "uciok";)
+        if (line.rfind("id name ", 0) == 0)
+          _name = line.substr(8);
+      ready();
+    } catch (...) {
+      close();
+      throw;
+    }
+  }
+
+  inline ~UciEngine() { close(); }
+
+  UciEngine(const UciEngine &) = delete;
+  UciEngine &operator=(const UciEngine &) = delete;
+
+  inline const std::string &name() const { return _name; }
+
+  inline void send(const std::string &line) {
+    if (std::fputs((line + '\n').c_str(), in) < 0 || std::fflush(in) != 0)
+      throw std::runtime_error("UciEngine: write failed");
+  }
+
+  // Read a line (throws if the engine closed its output, or if there is no
+  // line before the deadline: the engine is killed)
+  inline std::string read_line() { return read_line(Clock::now() + timeout); }
+
+  inline std::string read_line(Clock::time_point deadline) {
+    std::size_t eol;
+    while ((eol = buffer.find('\n')) == std::string::npos) {
+      const auto left = std::chrono::ceil<std::chrono::milliseconds>(
+          deadline - Clock::now());
+      pollfd p{out, POLLIN, 0};
+      const int ready =
+          left.count() > 0 ? poll(&p, 1, static_cast<int>(left.count())) : 0;
+      if (ready < 0 && errno == EINTR)
+        continue;
+      if (ready == 0) {
+        kill(pid, SIGKILL);
+        throw std::runtime_error("UciEngine: engine timed out");
+      }
+      char chunk[4096];
+      const ssize_t n = ready < 0 ? -1 : ::read(out, chunk, sizeof(chunk));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0) { // the last line can have no end of line
+        if (buffer.empty())
+          throw std::runtime_error("UciEngine: engine terminated");
+        eol = buffer.size();
+        buffer += '\n';
+        break;
+      }
+      buffer.append(chunk, static_cast<std::size_t>(n));
+    }
+    std::string line = buffer.substr(0, eol);
+    buffer.erase(0, eol + 1);
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    return line;
+  }
+
+  // isready / readyok
+  inline void ready() {
+    send("isready");
+    while (read_line() != "readyok")
+      ;
+  }
+
+  inline void set_option(const std::string &name, const std::string &value) {
+    send("setoption name " + name + " value " + value);
+  }
+
+  // Options in the form "Name=Value,Name=Value"
+  inline void set_options(const std::string &options) {
+    std::istringstream ss(options);
+    std::string option;
+    while (std::getline(ss, option, ',')) {
+      const auto eq = option.find('=');
+      if (eq == std::string::npos)
+        throw std::runtime_error("UciEngine: invalid option " + option);
+      set_option(option.substr(0, eq), option.substr(eq + 1));
+    }
+    ready();
+  }
+
+  inline void new_game() {
+    send("ucinewgame");
+    ready();
+  }
+
+  // position = "position ...", limits = what follows "go" (nodes 1000, ...)
+  inline GoResult go(const std::string &position, const std::string &limits) {
+    send(position);
+    send("go " + limits);
+
+    const Clock::time_point deadline = Clock::now() + timeout;
+    GoResult r;
+    while (true) {
+      const std::string line = read_line(deadline);
+      std::istringstream ss(line);
+      std::string token;
+      ss >> token;
+      if (token == "bestmove") {
+        ss >> r.bestMove;
+        if (r.bestMove.empty())
+          r.bestMove = "(none)";
+        return r;
+      }
+      if (token != "info")
+        continue;
+      while (ss >> token)
+        if (token == "score") {
+          std::string kind;
+          int value;
+          if (ss >> kind >> value) {
+            if (kind == "cp")
+              r.cp = value, r.mate.reset();
+            else if (kind == "mate")
+              r.mate = value, r.cp.reset();
+          }
+        }
+    }
+  }
+
+private:
+  // Ask the engine to quit and wait for it (killed after QUIT_TIMEOUT)
+  inline void close() {
+    if (in) {
+      std::fputs("quit\n", in);
+      std::fclose(in);
+      in = nullptr;
+    }
+    if (out >= 0) {
+      ::close(out);
+      out = -1;
+    }
+    if (pid > 0) {
+      const Clock::time_point deadline = Clock::now() + QUIT_TIMEOUT;
+      while (waitpid(pid, nullptr, WNOHANG) == 0) {
+        if (Clock::now() >= deadline) {
+          kill(pid, SIGKILL);
+          waitpid(pid, nullptr, 0);
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      }
+      pid = -1;
+    }
+  }
+
+  pid_t pid = -1;
+  std::FILE *in = nullptr; // engine stdin
+  int out = -1;            // engine stdout
+  std::string buffer;      // read from out, not yet returned by read_line
+  std::chrono::milliseconds timeout;
+  std::string _name;
+};
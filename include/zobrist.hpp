@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#include "gamestate.hpp"
+#include "piece.hpp"
+
+/*
+Zobrist keys of the positions (transposition table, repetitions)
+
+  key = xor of PIECE[color][type][square] of every piece
+        ^ CASTLE[rights] ^ EN_PASSANT[file] (if any) ^ SIDE (if black)
+
+The random numbers are generated at compile time with splitmix64, so the
+keys are the same in every build. The files of the castling rooks are not in
+the key: they can't change during a game.
+*/
+
+class Zobrist {
+public:
+  static inline uint64_t hash(const GameState &gs) {
+    uint64_t key = 0;
+    const Board &b = gs.board();
+    for (int c = 0; c < Piece::Color::COLOR_NB; ++c)
+      for (int t = Piece::Type::PAWN; t < Piece::Type::PIECE_NB; ++t)
+        for (uint64_t bb = b.bitboard(static_cast<Piece::Color>(c),
+                                      static_cast<Piece::Type>(t));
+             bb; bb &= bb - 1)
+          key ^= KEYS.piece[c][t][std::countr_zero(bb)];
+    return key ^ state(gs);
+  }
+
+  // Key of after from the key of before, only the bitboards that changed are
+  // visited (after is before with a move played)
+  static inline uint64_t update(uint64_t key, const GameState &before,
+                                const GameState &after) {
+    const Board &b = before.board(), &a = after.board();
+    for (int c = 0; c < Piece::Color::COLOR_NB; ++c)
+      for (int t = Piece::Type::PAWN; t < Piece::Type::PIECE_NB; ++t) {
+        const auto color = static_cast<Piece::Color>(c);
+        const auto type = static_cast<Piece::Type>(t);
+        for (uint64_t bb = b.bitboard(color, type) ^ a.bitboard(color, type);
+             bb; bb &= bb - 1)
+          key ^= KEYS.piece[c][t][std::countr_zero(bb)];
+      }
+    return key ^ state(before) ^ state(after);
+  }
+
+private:
+  struct Keys {
+    uint64_t piece[Piece::Color::COLOR_NB][Piece::Type::PIECE_NB][64];
+    uint64_t castle[16];
+    uint64_t enPassant[8];
+    uint64_t side;
+  };
+
+  static constexpr Keys KEYS = [] {
+    Keys k{};
+    uint64_t seed = 0x7157E51A5EEDULL;
+    auto next = [&seed] { // splitmix64
+      uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+    };
+    for (auto &color : k.piece)
+      for (auto &type : color)
+        for (auto &sq : type)
+          sq = next();
+    for (auto &c : k.castle)
+      c = next();
+    for (auto &e : k.enPassant)
+      e = next();
+    k.side = next();
+    return k;
+  }();
+
+  // the part of the key that is not the pieces
+  static inline uint64_t state(const GameState &gs) {
+    uint64_t key = KEYS.castle[uint8_t(gs.castleRights())];
+    if (gs.enPassantSquare() != Square::NONE)
+      key ^= KEYS.enPassant[gs.enPassantSquare() % 8];
+    if (gs.turn() == Piece::Color::BLACK)
+      key ^= KEYS.side;
+    return key;
+  }
+};
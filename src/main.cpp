@@ -1,11 +1,48 @@
 // STD
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 // Tiresia
+#include "analyse.hpp"
+#include "cli.hpp"
+#include "datagen.hpp"
 #include "libtiresia.hpp"
+#include "match.hpp"
+#include "server.hpp"
+#include "tuner.hpp"
 
-int main() {
+// UCI score: the mate scores (MATE - ply of the mate) as moves to the mate,
+// negative when the side to move is mated
+static std::string uci_score(int score) {
+  if (std::abs(score) <= TranspositionTable::MATE_BOUND)
+    return "cp " + std::to_string(score);
+  const int moves = (Searcher::MATE - std::abs(score) + 1) / 2;
+  return "mate " + std::to_string(score > 0 ? moves : -moves);
+}
+
+// Print the lines of a search as UCI info, best first
+static void info(const std::vector<SearchResult> &lines, bool chess960) {
+  for (std::size_t k = 0; k < lines.size(); ++k) {
+    const SearchResult &r = lines[k];
+    std::cout << "info multipv " << k + 1 << " depth " << r.depth
+              << " score " << uci_score(r.score) << " nodes " << r.nodes;
+    if (!r.pv.empty()) {
+      std::cout << " pv";
+      for (const Move &m : r.pv)
+        std::cout << ' ' << m.to_string(chess960);
+    }
+    std::cout << '\n';
+  }
+}
+
+static int uci() {
   std::string line;
 
   // board of the game witch will be used to test the capabilites of the library
@@ -14,21 +51,129 @@ int main() {
   board.print(Board::get_ascii_piece);
   board.print(Board::get_utf8_piece);
 
+  GameState gs;
+  Searcher searcher;
+  int multiPV = 1;
+  bool chess960 = false; // UCI_Chess960: castling as king takes rook
+  std::shared_ptr<const EvalParams> params; // EvalFile, nullptr = defaults
+
   while (std::getline(std::cin, line)) {
+    std::istringstream ss(line);
+    std::string token;
+    ss >> token;
     if (line == "uci") {
       std::cout << "id name Tiresia 1.0\n";
       std::cout << "id author github.com/CarloDalCin\n";
+      std::cout << "option name Hash type spin default "
+                << TranspositionTable::DEFAULT_MB << " min 1 max 65536\n";
+      std::cout << "option name MultiPV type spin default 1 min 1 max 256\n";
+      std::cout << "option name EvalFile type string default <empty>\n";
+      std::cout << "option name UCI_Chess960 type check default false\n";
       std::cout << "uciok" << std::endl;
     } else if (line == "isready") {
       std::cout << "readyok" << std::endl;
     } else if (line == "quit") {
       break;
-    } else if (line.rfind("position", 0) == 0) {
-      // Qui dovresti caricare la posizione in base alla FEN o alle mosse
-    } else if (line.rfind("go", 0) == 0) {
-      std::cout << "bestmove " /*<< bestMove() */ << std::endl;
+    } else if (token == "setoption") {
+      // setoption name <name> value <value>
+      std::string name, value;
+      ss >> token >> name >> token >> value;
+      // the table is zeroed by one thread per core (pages spread on the
+      // NUMA nodes)
+      if (name == "Hash" && !value.empty())
+        searcher.resize(
+            TranspositionTable::entries(std::clamp(
+                std::atoi(value.c_str()), 1, 65536)),
+            std::max(1u, std::thread::hardware_concurrency()));
+      if (name == "MultiPV" && !value.empty())
+        multiPV = std::clamp(std::atoi(value.c_str()), 1, 256);
+      if (name == "UCI_Chess960")
+        chess960 = value == "true";
+      if (name == "EvalFile") {
+        // the file of `tiresia tune`, <empty> = the default parameters
+        try {
+          params = value.empty() || value == "<empty>"
+                       ? nullptr
+                       : std::make_shared<const EvalParams>(
+                             EvalParams::load(value));
+        } catch (const std::exception &e) {
+          std::cout << "info string " << e.what() << std::endl;
+        }
+      }
+    } else if (token == "position") {
+      // position [startpos | fen <fen>] [moves <move> ...]
+      try {
+        ss >> token;
+        if (token == "fen") {
+          std::string fen, field;
+          while (ss >> field && field != "moves")
+            fen += (fen.empty() ? "" : " ") + field;
+          gs = GameState(fen);
+          token = field;
+        } else {
+          gs = GameState::init_std();
+          ss >> token;
+        }
+        if (token == "moves")
+          while (ss >> token)
+            gs.make_move(gs.move_from_uci(token));
+      } catch (const std::exception &e) {
+        std::cout << "info string " << e.what() << std::endl;
+      }
+    } else if (token == "go") {
+      SearchLimits limits;
+      limits.multiPV = multiPV;
+      limits.params = params;
+      while (ss >> token) {
+        if (token == "depth")
+          ss >> limits.depth;
+        else if (token == "nodes")
+          ss >> limits.nodes;
+      }
+      // there is no time management: the other go commands (movetime,
+      // wtime, infinite, ...) search at a fixed depth
+      if (!limits.depth && !limits.nodes)
+        limits.depth = 8;
+      const std::vector<SearchResult> lines =
+          searcher.search_multipv(gs, limits);
+      info(lines, chess960);
+      // no line or no move: checkmate or stalemate
+      const bool none = lines.empty() || !lines.front().bestMove;
+      std::cout << "bestmove "
+                << (none ? "(none)"
+                         : lines.front().bestMove->to_string(chess960))
+                << std::endl;
     }
   }
 
   return 0;
 }
+
+int main(int argc, char **argv) {
+  // without a mode the engine talks UCI on stdin/stdout
+  if (argc < 2)
+    return uci();
+
+  const std::string mode = argv[1];
+  try {
+    const Args args(argc, argv);
+    if (mode == "analyse")
+      return Analyse::run(args) == 0 ? 0 : 1;
+    if (mode == "datagen")
+      return Datagen::run(args);
+    if (mode == "tune")
+      return Tuner::run(args);
+    if (mode == "match")
+      return Match::run(args);
+    if (mode == "server")
+      return Server::run(args);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  std::fprintf(stderr, "Unknown mode: %s\n", mode.c_str());
+  std::fprintf(stderr, "usage: tiresia [analyse|datagen|tune|match|server] "
+                       "[--option value ...]\n");
+  return 1;
+}
@@ -1,15 +1,35 @@
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <print>
+#include <random>
+#include <sstream>
 #include <string>
+#include <thread>
 
 // Include le tue classi
+#include "analyse.hpp"
 #include "board.hpp"
 #include "castle.hpp"
+#include "datafile.hpp"
+#include "datagen.hpp"
 #include "gamestate.hpp"
 #include "libtiresia.hpp"
+#include "match.hpp"
 #include "move.hpp"
+#include "movegen.hpp"
+#include "packed.hpp"
 #include "piece.hpp"
+#include "server.hpp"
+#include "sprt.hpp"
+#include "tuner.hpp"
+#include "uciengine.hpp"
+#include "zobrist.hpp"
 
 int main() {
   std::cout << "libtiresia test suite" << std::endl;
@@ -41,6 +61,679 @@ int main() {
   assert(m.type() == Move::Type::NORMAL);
 #endif
 
+  // Test LargeTable: huge page alignment, zeroed entries and move semantics
+  {
+    LargeTable<uint64_t> t(1000, 2);
+    assert(t.size() == 1000 && t.bytes() == 8000);
+    assert(reinterpret_cast<std::uintptr_t>(t.data()) % LargePage::SIZE == 0);
+    assert(std::all_of(t.data(), t.data() + t.size(),
+                       [](uint64_t v) { return v == 0; }));
+    for (std::size_t i = 0; i < t.size(); ++i)
+      t[i] = i + 1;
+
+    LargeTable<uint64_t> moved(std::move(t));
+    assert(!t.data() && t.size() == 0);
+    assert(moved.size() == 1000 && moved[999] == 1000);
+    t = std::move(moved);
+    assert(!moved.data() && t[0] == 1);
+
+    t.clear(3);
+    assert(std::all_of(t.data(), t.data() + t.size(),
+                       [](uint64_t v) { return v == 0; }));
+    t.resize(0);
+    assert(!t.data() && t.size() == 0 && t.bytes() == 0);
+
+    // any index is mapped on the CPUs the process can use
+    std::thread([] { assert(LargePage::pin_current_thread(12345)); }).join();
+  }
+
+  // Test TranspositionTable: the size in MB, zeroed by many threads
+  {
+    TranspositionTable tt(TranspositionTable::entries(4), 3);
+    assert(tt.size() == 4 * 1024 * 1024 / sizeof(TranspositionTable::Entry));
+    assert(!tt.probe(0x1234));
+    tt.store(0x1234, 0, 42, 5, TranspositionTable::EXACT, 0);
+    assert(tt.probe(0x1234) && tt.probe(0x1234)->score == 42);
+    tt.resize(TranspositionTable::entries(1), 2);
+    assert(tt.size() == 1024 * 1024 / sizeof(TranspositionTable::Entry));
+    assert(!tt.probe(0x1234));
+  }
+
+  // Test Chess960 (518 is the standard position)
+  assert(Board::init_960(518) == Board::init_std());
+
+  // Test Board::move_piece and set_piece on an occupied square: the piece
+  // on the target is replaced, no bitboard keeps it
+  {
+    Board board = Board::init_std();
+    board.move_piece(Square::D1, Square::D7);
+    board.set_piece(Square::E8, Piece('Q'));
+    assert(board == Board("rnbqQbnr/pppQpppp/8/8/8/8/PPPPPPPP/RNB1KBNR"));
+    assert(board.occupancy(Piece::Color::WHITE) ==
+           ((0xFFFFULL & ~Square::to_uint64(Square::D1)) |
+            Square::to_uint64(Square::D7, Square::E8)));
+    assert(board.occupancy() == (board.occupancy(Piece::Color::WHITE) |
+                                 board.occupancy(Piece::Color::BLACK)));
+    GameState g = GameState::init_std();
+    g.move_piece(Square::A1, Square::A8);
+    assert(g.board() == Board("Rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/1NBQKBNR"));
+    assert(alignof(GameState) == 64 && sizeof(GameState) == 128);
+  }
+
+  // Test GameState::make_move
+  {
+    GameState g = GameState::init_std();
+    g.make_move(Move(Square::E2, Square::E4, Move::Type::DOUBLE_PAWN_PUSH));
+    assert(g == GameState("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b "
+                          "KQkq e3 0 1"));
+    GameState c("r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 5 10");
+    c.make_move(Move(Square::E1, Square::H1, Move::Type::CASTLING));
+    assert(c == GameState("r3k2r/8/8/8/8/8/8/R4RK1 b kq - 6 10"));
+    assert(!c.in_check());
+    assert(GameState("4k3/8/8/b7/8/8/8/4K3 w - - 0 1").in_check());
+  }
+
+  // Test MoveGen: perft of the reference positions (standard and Chess960)
+  // ref: https://www.chessprogramming.org/Perft_Results
+  {
+    const struct {
+      const char *fen;
+      int depth;
+      uint64_t nodes;
+    } perfts[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 4,
+         197281},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 "
+         "1",
+         3, 97862},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 4, 43238},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 3,
+         9467},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 3, 62379},
+        {"bqnb1rkr/pp3ppp/3ppn2/2p5/5P2/P2P4/NPP1P1PP/BQ1BNRKR w HFhf - 2 9", 3,
+         12189},
+        {"2nnrbkr/p1qppppp/8/1ppb4/6PP/3PP3/PPP2P2/BQNNRBKR w HEhe - 1 9", 3,
+         18002},
+    };
+    for (const auto &p : perfts)
+      assert(MoveGen::perft(GameState(p.fen), p.depth) == p.nodes);
+    assert(MoveGen::legal_moves(GameState::init_std()).size() == 20);
+  }
+
+  // Test Zobrist: the incremental key is the key from scratch, and the same
+  // position reached by different orders has the same key
+  {
+    GameState a = GameState::init_std(), b = a;
+    uint64_t key = Zobrist::hash(a);
+    for (const char *uci : {"g1f3", "g8f6", "b1c3", "b8c6", "e2e4", "d7d5",
+                            "e4d5", "e7e5", "d5e6", "f8c5", "e1h1"}) {
+      const GameState before = a;
+      a.make_move(a.move_from_uci(uci));
+      key = Zobrist::update(key, before, a);
+      assert(key == Zobrist::hash(a));
+    }
+    for (const char *uci : {"b1c3", "b8c6", "g1f3", "g8f6"})
+      b.make_move(b.move_from_uci(uci));
+    GameState c = GameState::init_std();
+    for (const char *uci : {"g1f3", "g8f6", "b1c3", "b8c6"})
+      c.make_move(c.move_from_uci(uci));
+    assert(Zobrist::hash(b) == Zobrist::hash(c));
+    assert(Zobrist::hash(b) != Zobrist::hash(GameState::init_std()));
+  }
+
+  // Test Searcher: the limits are honoured and the best move is found
+  {
+    Searcher searcher;
+    SearchLimits limits;
+    limits.depth = 4;
+    const GameState kiwipete(
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    const SearchResult r = searcher.search(kiwipete, limits);
+    assert(r.depth == 4 && r.bestMove && r.nodes > 0);
+    assert(!r.pv.empty() && r.pv.front() == *r.bestMove);
+    assert(MoveGen::legal(kiwipete, *r.bestMove));
+
+    // back rank mate in 1 and the score of the mate
+    const SearchResult mate =
+        searcher.search(GameState("6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1"),
+                        limits);
+    assert(mate.bestMove && mate.bestMove->to_string() == "a1a8");
+    assert(mate.score == Searcher::MATE - 1);
+
+    // win the hanging queen
+    const SearchResult queen = searcher.search(
+        GameState("4k3/8/8/3q4/8/8/3R4/4K3 w - - 0 1"), limits);
+    assert(queen.bestMove->to_string() == "d2d5" && queen.score > 400);
+
+    // checkmated and stalemated: no move
+    assert(!searcher.search(GameState("R5k1/5ppp/8/8/8/8/5PPP/6K1 b - - 0 1"),
+                            limits)
+                .bestMove);
+    assert(searcher.search(GameState("7k/5Q2/6K1/8/8/8/8/8 b - - 0 1"), limits)
+               .score == 0);
+
+    // the node limit stops the search after the first iteration
+    SearchLimits nodes;
+    nodes.nodes = 5000;
+    const SearchResult n = searcher.search(kiwipete, nodes);
+    assert(n.nodes <= 5000 && n.depth >= 1 && n.bestMove);
+
+    // stopped before starting: still a legal move
+    const std::atomic<bool> stop = true;
+    SearchLimits stopped;
+    stopped.stop = &stop;
+    const SearchResult s = searcher.search(kiwipete, stopped);
+    assert(s.depth == 0 && s.bestMove && MoveGen::legal(kiwipete, *s.bestMove));
+  }
+
+  // Test Epd: EPD operations, full FEN and the clocks
+  {
+    const Epd epd("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 "
+                  "bm e5; id \"open; e4\"; hmvc 3; fmvn 7;");
+    assert(epd.position ==
+           "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3");
+    assert(epd.operation("bm") == "e5");
+    assert(epd.operation("id") == "\"open; e4\"");
+    assert(epd.operation("ce").empty());
+    assert(epd.halfMoveClock == 3 && epd.fullMoveNumber == 7);
+    assert(epd.gamestate() ==
+           GameState("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 "
+                     "3 7"));
+
+    const Epd fen("8/8/8/8/8/8/8/4K2k w - - 12 40 id \"fen\";");
+    assert(fen.halfMoveClock == 12 && fen.fullMoveNumber == 40);
+    assert(fen.operation("id") == "\"fen\"");
+
+    assert(!Epd::is_record("   ") && !Epd::is_record("# comment"));
+    bool thrown = false;
+    try {
+      Epd("8/8/8 w");
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  // Test ThreadPool: every task runs once, on a valid worker
+  {
+    ThreadPool pool(4);
+    assert(pool.size() == 4);
+    std::vector<std::atomic<int>> runs(1000);
+    std::atomic<bool> bad_worker = false;
+    for (int round = 0; round < 2; ++round) {
+      for (std::size_t i = 0; i < runs.size(); ++i)
+        pool.submit([&, i](std::size_t worker) {
+          if (worker >= pool.size())
+            bad_worker = true;
+          ++runs[i];
+        });
+      pool.wait();
+    }
+    assert(!bad_worker);
+    assert(std::all_of(runs.begin(), runs.end(),
+                       [](const std::atomic<int> &r) { return r == 2; }));
+  }
+
+  // Test Analyse: the records are written in input order by many threads and
+  // an invalid record gets an error in its slot
+  {
+    std::string input = "# comment\n\n";
+    for (int i = 0; i < 40; ++i) {
+      input += i == 17 ? "invalid record id \"17\";"
+                       : "4k3/8/8/8/8/8/4P3/4K3 w - - id \"" +
+                             std::to_string(i) + "\";";
+      input += '\n';
+    }
+    std::istringstream in(input);
+    std::ostringstream out;
+    Analyse::Options opt;
+    opt.limits.depth = 2;
+    opt.threads = 4;
+    opt.window = 3;
+    assert(Analyse::run(in, out, opt) == 1);
+
+    std::istringstream lines(out.str());
+    std::string line;
+    int i = 0;
+    for (; std::getline(lines, line); ++i) {
+      if (i == 17) {
+        assert(line.rfind("invalid record id \"17\"; error \"", 0) == 0);
+        continue;
+      }
+      assert(line.find(" acd 2; ") != std::string::npos);
+      assert(line.find(" bm ") != std::string::npos);
+      assert(line.ends_with(" id \"" + std::to_string(i) + "\";"));
+    }
+    assert(i == 40);
+  }
+
+  // Test Chess960 castle rights: X-FEN / Shredder-FEN and the rights lost by
+  // the actual castling rooks
+  {
+    GameState g = GameState::init_960(133); // nrbbqnkr
+    assert(g.castleRights().to_string() == "KBkb");
+    assert(g == GameState("nrbbqnkr/pppppppp/8/8/8/8/PPPPPPPP/NRBBQNKR w "
+                          "HBhb - 0 1"));
+    assert(GameState("rk5r/8/8/8/8/8/8/RK5R w HAha - 0 1").castleRights() ==
+           CastleRights::all());
+    g.remove_piece(Square::B2);
+    g.make_move(Move(Square::B1, Square::B3));
+    assert(g.castleRights().to_string() == "Kkb");
+    g.make_move(Move(Square::E7, Square::E5, Move::Type::DOUBLE_PAWN_PUSH));
+    g.make_move(Move(Square::H1, Square::H3)); // not the a1 / h1 of std
+    assert(g.castleRights().to_string() == "kb");
+
+    GameState c("1r4k1/8/8/8/8/8/8/1R4KR w KQkq - 0 1");
+    assert(c.castleRights().to_string() == "KBb"); // k: no rook after g8
+    c.make_move(c.move_from_uci("g1e1")); // O-O-O, king c1 and rook d1
+    assert(c == GameState("1r4k1/8/8/8/8/8/8/2KR3R b b - 1 1"));
+    const PackedPosition packed(GameState::init_960(133));
+    assert(packed.unpack() == GameState::init_960(133));
+  }
+
+  // Test GameState::move_from_uci
+  {
+    const GameState g("r3k2r/8/8/3pP3/8/8/P7/R3K2R w KQkq d6 0 1");
+    assert(g.move_from_uci("e1g1") == Move::Type::CASTLING);
+    assert(g.move_from_uci("e1g1").to() == Square::H1);
+    assert(g.move_from_uci("e5d6") == Move::Type::EN_PASSANT);
+    assert(g.move_from_uci("a2a4") == Move::Type::DOUBLE_PAWN_PUSH);
+    assert(g.move_from_uci("a1a2") == Move::Type::NORMAL);
+    // castling printed as the king on its rook (Chess960) or to the g/c file
+    assert(g.move_from_uci("e1g1").to_string() == "e1h1");
+    assert(g.move_from_uci("e1g1").to_string(false) == "e1g1");
+    assert(g.move_from_uci("e1a1").to_string(false) == "e1c1");
+    assert(g.move_from_uci("a1a2").to_string(false) == "a1a2");
+  }
+
+  // Test Sprt
+  {
+    const Sprt sprt(0, 5);
+    assert(sprt.test({0, 0, 0, 0, 0}) == Sprt::CONTINUE);
+    assert(sprt.test({1000, 4000, 10000, 4000, 1000}) == Sprt::H0);
+    assert(sprt.test({50, 300, 1000, 500, 150}) == Sprt::H1);
+    // a few pairs decide nothing, even if they are all won
+    assert(sprt.test({0, 0, 0, 0, Sprt::MIN_PAIRS - 1}) == Sprt::CONTINUE);
+    assert(sprt.llr({0, 0, 0, 0, 5}) < sprt.upper());
+    assert(sprt.llr({0, 0, 5, 0, 0}) > sprt.lower());
+  }
+
+  // Test UciEngine: an engine that does not answer go is killed, an engine
+  // that ignores quit does not block close
+  {
+    const std::string handshake =
+        "read l; echo uciok; read l; echo readyok; ";
+    const auto start = std::chrono::steady_clock::now();
+    {
+      UciEngine silent(handshake + "while read l; do :; done",
+                       std::chrono::milliseconds(200));
+      bool thrown = false;
+      try {
+        silent.go("position startpos", "depth 1");
+      } catch (const std::runtime_error &) {
+        thrown = true;
+      }
+      assert(thrown);
+      UciEngine stuck(handshake + "exec sleep 60");
+    }
+    assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+  }
+
+  // Test Match: games between 2 instances of the engine (built by make
+  // run-tests), the results of every pair are counted
+  {
+    assert(access("build/tiresia", X_OK) == 0);
+    Match::Options opt;
+    opt.engine = {"build/tiresia", "build/tiresia"};
+    opt.games = 4;
+    opt.concurrency = 2;
+    opt.limits = "depth 2";
+    opt.maxPlies = 40;
+    Match match(opt);
+    assert(match.run() == Sprt::CONTINUE);
+    assert(Sprt::pairs(match.results()) == 2);
+  }
+  {
+    // scripted engines: the knights go out and back (the start position
+    // repeats every 4 plies), the engine after the limit plays a1a1
+    const auto engine = [](int limit) {
+      return "while read l; do case \"$l\" in uci) echo uciok;; "
+             "isready) echo readyok;; "
+             "position*) set -- $l; n=$(($# > 8 ? $# - 9 : 0));; "
+             "go*) if [ $n -ge " +
+             std::to_string(limit) +
+             " ]; then echo bestmove a1a1; else case $((n % 4)) in "
+             "0) echo bestmove g1f3;; 1) echo bestmove g8f6;; "
+             "2) echo bestmove f3g1;; *) echo bestmove f6g8;; esac; fi;; "
+             "esac; done";
+    };
+    Match::Options opt;
+    opt.games = 2;
+    opt.concurrency = 1;
+    // an illegal move loses, with white and with black
+    opt.engine = {engine(0), engine(1000)};
+    Match illegal(opt);
+    illegal.run();
+    assert((illegal.results() == Sprt::Pentanomial{1, 0, 0, 0, 0}));
+    // the third time of the start position (ply 8) is a draw, before the
+    // illegal moves of engine1
+    opt.engine = {engine(8), engine(1000)};
+    Match repetition(opt);
+    repetition.run();
+    assert((repetition.results() == Sprt::Pentanomial{0, 0, 1, 0, 0}));
+  }
+
+  // Test PackedPosition (round trip with GameState)
+  for (const char *fen : {
+           "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+           "rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e6 0 2",
+           "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b Kq - "
+           "3 47",
+           "8/8/8/8/8/8/8/4K2k w - - 120 300",
+       }) {
+    const GameState original(fen);
+    const PackedPosition packed(original);
+    assert(sizeof(packed) == 32);
+    assert(packed.unpack() == original);
+    assert(PackedPosition(packed.unpack()) == packed);
+  }
+  {
+    // positions of random Chess960 games (castling rooks, promotions, ...)
+    std::mt19937_64 rng(3);
+    for (int game = 0; game < 200; ++game) {
+      GameState gs = GameState::init_960(static_cast<int>(rng() % 960));
+      const int plies = static_cast<int>(rng() % 120);
+      for (int ply = 0; ply < plies; ++ply) {
+        const MoveList moves = MoveGen::legal_moves(gs);
+        if (moves.empty())
+          break;
+        gs.make_move(moves[static_cast<int>(rng() % moves.size())]);
+      }
+      assert(PackedPosition(gs).unpack() == gs);
+    }
+  }
+  {
+    // piece code 0 (no piece) on an occupied square
+    auto raw = std::bit_cast<std::array<uint8_t, sizeof(PackedPosition)>>(
+        PackedPosition(GameState("8/8/8/8/8/8/8/4K2k w - - 0 1")));
+    raw[8] &= 0xF0; // first nibble of the pieces, the king on e1
+    bool thrown = false;
+    try {
+      std::bit_cast<PackedPosition>(raw).unpack();
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  // Test DataWriter / DataReader
+  {
+    const std::string path = "build/test_datafile.bin";
+    {
+      DataWriter writer(path);
+      for (int i = 0; i < 100; ++i) {
+        PackedPosition p(GameState::init_std());
+        p.set_score(static_cast<int16_t>(i - 50));
+        p.set_result(PackedPosition::Result::WIN);
+        writer.write(p);
+      }
+    }
+    DataReader reader(path);
+    assert(reader.size() == 100);
+    int i = 0;
+    reader.for_each([&](const PackedPosition &p) {
+      assert(p.score() == i - 50 && p.result() == PackedPosition::WIN);
+      assert(p.unpack() == GameState::init_std());
+      ++i;
+    });
+    std::remove(path.c_str());
+  }
+
+  // Test Datagen: the games write quiet positions with their result
+  {
+    Datagen::Options opt;
+    opt.output = "build/test_datagen.bin";
+    opt.games = 4;
+    opt.threads = 2;
+    opt.limits.nodes = 1000;
+    opt.seed = 1;
+    opt.maxPlies = 80;
+    const Datagen::Stats stats = Datagen::run(opt);
+    assert(stats.games == 4 && stats.positions > 0);
+    DataReader reader(opt.output);
+    assert(reader.size() == stats.positions);
+    reader.for_each([](const PackedPosition &p) {
+      const GameState gs = p.unpack();
+      assert(!gs.in_check() && !MoveGen::legal_moves(gs).empty());
+      assert(p.result() >= PackedPosition::LOSS &&
+             p.result() <= PackedPosition::WIN);
+    });
+    std::remove(opt.output.c_str());
+  }
+
+  // Test EvalParams: the file of the tuner is read back (a1 first)
+  {
+    EvalParams params = EvalParams::defaults();
+    params.pieceValue[Piece::Type::KNIGHT] = 321;
+    params.pst[Piece::Type::PAWN][Square::E2] = -7;
+    params.pst[Piece::Type::KING][Square::G1] = 25;
+    const std::string path = "build/test_params.txt";
+    std::FILE *out = std::fopen(path.c_str(), "w");
+    assert(out);
+    params.save(out);
+    std::fclose(out);
+    assert(EvalParams::load(path) == params);
+    std::remove(path.c_str());
+  }
+
+  // Test Tuner on synthetic positions whose results follow known piece
+  // values: K is fitted, the gradient is the finite difference of the loss
+  // and the tuning recovers the eval
+  {
+    EvalParams truth = EvalParams::defaults();
+    truth.pieceValue = {0, 100, 350, 320, 450, 1000, 0};
+    constexpr double K = 1.5;
+
+    // positions of random legal games (reproducible)
+    std::mt19937_64 rng(7);
+    std::vector<GameState> positions;
+    Tuner::Dataset data;
+    while (positions.size() < 400) {
+      GameState gs = GameState::init_std();
+      const int plies = static_cast<int>(rng() % 160);
+      for (int ply = 0; ply < plies; ++ply) {
+        const MoveList moves = MoveGen::legal_moves(gs);
+        if (moves.empty())
+          break;
+        gs.make_move(moves[static_cast<int>(rng() % moves.size())]);
+      }
+      const int eval = Eval::material(gs.board(), truth);
+      data.add(PackedPosition(gs),
+               static_cast<float>(1 / (1 + std::pow(10, -K * eval / 400))));
+      positions.push_back(gs);
+    }
+
+    Tuner::Options opt;
+    opt.threads = 2;
+    opt.epochs = 400;
+    opt.lr = 2.0;
+    Tuner tuner(data, opt);
+
+    tuner.fit_k(Tuner::to_vector(truth));
+    assert(std::abs(tuner.k - K) < 0.05);
+
+    // central finite difference of the loss, at the default parameters
+    std::vector<double> theta = Tuner::to_vector(Eval::DEFAULT_PARAMS);
+    std::vector<double> grad(Tuner::PARAMS);
+    tuner.gradient(theta, grad);
+    for (const int i : {Piece::Type::KNIGHT * Tuner::STRIDE,
+                        Piece::Type::ROOK * Tuner::STRIDE,
+                        Piece::Type::PAWN * Tuner::STRIDE + 1 + Square::E4}) {
+      constexpr double h = 0.01;
+      std::vector<double> plus = theta, minus = theta;
+      plus[i] += h;
+      minus[i] -= h;
+      const double fd = (tuner.loss(plus) - tuner.loss(minus)) / (2 * h);
+      assert(grad[i] != 0);
+      assert(std::abs(fd - grad[i]) <= 1e-4 * std::abs(grad[i]));
+    }
+
+    // mean error of the eval in centipawns, where the result is not decided
+    // (the sigmoid is flat for the large evals, they carry no information)
+    const auto error = [&](const EvalParams &params) {
+      double sum = 0;
+      int n = 0;
+      for (const GameState &gs : positions) {
+        const int eval = Eval::material(gs.board(), truth);
+        if (std::abs(eval) >= 400)
+          continue;
+        sum += std::abs(Eval::material(gs.board(), params) - eval);
+        ++n;
+      }
+      assert(n > 100);
+      return sum / n;
+    };
+    const EvalParams tuned = tuner.tune(Eval::DEFAULT_PARAMS);
+    assert(error(Eval::DEFAULT_PARAMS) > 25);
+    assert(error(tuned) < 3);
+  }
+
+  // Test MultiPV: the lines are ranked best first, the best line is the one
+  // of a normal search and the excluded moves are never searched
+  {
+    Searcher searcher;
+    SearchLimits limits;
+    limits.depth = 4;
+    limits.multiPV = 3;
+    // Rxb5 trades a rook for the queen, the other moves lose material
+    const GameState gs("6k1/8/8/1q3r2/8/8/8/1R3RK1 w - - 0 1");
+    const auto lines = searcher.search_multipv(gs, limits);
+    assert(lines.size() == 3);
+    for (const SearchResult &r : lines)
+      assert(r.depth == 4 && r.bestMove && r.pv.front() == *r.bestMove);
+    assert(lines[0].score >= lines[1].score &&
+           lines[1].score >= lines[2].score);
+    assert(lines[0].bestMove->to_string() == "b1b5");
+    assert(lines[0].score > lines[1].score + 200);
+    assert(*lines[0].bestMove != *lines[1].bestMove &&
+           *lines[1].bestMove != *lines[2].bestMove &&
+           *lines[0].bestMove != *lines[2].bestMove);
+
+    SearchLimits single = limits;
+    single.multiPV = 1;
+    const SearchResult best = searcher.search(gs, single);
+    assert(*best.bestMove == *lines[0].bestMove &&
+           best.score == lines[0].score);
+
+    // without the best move the best line is the second one
+    single.excluded = {*lines[0].bestMove};
+    const SearchResult second = searcher.search(gs, single);
+    assert(*second.bestMove != *lines[0].bestMove);
+    assert(second.score == lines[1].score);
+
+    // less root moves than lines
+    limits.multiPV = 10;
+    assert(searcher.search_multipv(GameState("7k/8/8/8/8/8/8/K7 w - - 0 1"),
+                                   limits)
+               .size() == 3);
+    // no move: a single line without best move
+    const auto mated = searcher.search_multipv(
+        GameState("R5k1/5ppp/8/8/8/8/5PPP/6K1 b - - 0 1"), limits);
+    assert(mated.size() == 1 && !mated[0].bestMove &&
+           mated[0].score == -Searcher::MATE);
+  }
+
+  // Test Server: a request, an invalid request and the shutdown
+  {
+    Server::Options opt;
+    opt.socket = "build/test_server.sock";
+    opt.instances = 2;
+    Server server(opt);
+    std::thread serving([&] { server.serve(); });
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    const sockaddr_un addr = Server::address(opt.socket);
+    const int connected =
+        connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr));
+    assert(connected == 0);
+    const std::string request =
+        "go 1 fen rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1\n"
+        "go 2 fen invalid\n";
+    const ssize_t written = write(fd, request.data(), request.size());
+    assert(written == static_cast<ssize_t>(request.size()));
+    std::string replies;
+    char buffer[256];
+    ssize_t n;
+    while (std::count(replies.begin(), replies.end(), '\n') < 2 &&
+           (n = read(fd, buffer, sizeof(buffer))) > 0)
+      replies.append(buffer, n);
+    assert(replies.find("result 1 score cp ") != std::string::npos);
+    assert(replies.find("bestmove (none)") == std::string::npos);
+    assert(replies.find("error 2 ") != std::string::npos);
+    const ssize_t sent = write(fd, "shutdown\n", 9);
+    assert(sent == 9);
+    serving.join();
+    close(fd);
+  }
+
+  // Test Server: cancel a running request and a queued one (one instance)
+  {
+    Server::Options opt;
+    opt.socket = "build/test_server.sock";
+    opt.instances = 1;
+    Server server(opt);
+    std::thread serving([&] { server.serve(); });
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    const sockaddr_un addr = Server::address(opt.socket);
+    const int connected =
+        connect(fd, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr));
+    assert(connected == 0);
+    const auto start = std::chrono::steady_clock::now();
+    const std::string request =
+        "go 1 fen rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 "
+        "depth 30\n"
+        "go 2 fen rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 "
+        "depth 30\n";
+    const ssize_t written = write(fd, request.data(), request.size());
+    assert(written == static_cast<ssize_t>(request.size()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    const std::string cancel = "cancel 1\ncancel 2\n";
+    const ssize_t cancelWritten = write(fd, cancel.data(), cancel.size());
+    assert(cancelWritten == static_cast<ssize_t>(cancel.size()));
+    std::string replies;
+    char buffer[256];
+    ssize_t n;
+    while (std::count(replies.begin(), replies.end(), '\n') < 2 &&
+           (n = read(fd, buffer, sizeof(buffer))) > 0)
+      replies.append(buffer, n);
+    assert(replies.find("cancelled 1\n") != std::string::npos);
+    assert(replies.find("cancelled 2\n") != std::string::npos);
+    assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+    const ssize_t sent = write(fd, "shutdown\n", 9);
+    assert(sent == 9);
+    serving.join();
+    close(fd);
+  }
+
+  // Test Server: a file that is not a socket is never removed
+  {
+    Server::Options opt;
+    opt.socket = "build/test_server.txt";
+    opt.instances = 1;
+    std::FILE *file = std::fopen(opt.socket.c_str(), "w");
+    assert(file);
+    std::fclose(file);
+    bool thrown = false;
+    try {
+      Server server(opt);
+    } catch (const std::runtime_error &) {
+      thrown = true;
+    }
+    assert(thrown && access(opt.socket.c_str(), F_OK) == 0);
+    std::remove(opt.socket.c_str());
+  }
+
   GameState gs = GameState::init_std();
 
   std::string line;